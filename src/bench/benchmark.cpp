@@ -0,0 +1,343 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "model.h"
+#include "restart.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Benchmark of the generation, without rendering
+ * Usage: ./WFCBenchmark [tileset X Y Z runs backtrack periodic counters lookahead candidates]
+ * counters: 1 to propagate with SupportCounters instead of Bitsets
+ * Runs the same seeds on each layout of the wave and order of the cells, and reports the time per run
+ * and, on Linux when the hardware counters are available, the cache misses per run.
+ * Then compares the heuristics choosing the cell to observe, on the default layout and order.
+ * lookahead: if above 0, also runs the seeds with a lookahead of this radius trying up to candidates tiles
+ * per decision, and reports the restarts it saves: the runs which fail, per generated world, without and with it.
+ * Run it from the build folder, like RandomTilemapGeneration, so that ../tileset is found.
+ */
+
+/**
+ * Hardware event counter of this thread, in user space, from perf_event_open
+ */
+class Counter {
+public:
+	/**
+	 * @param config a PERF_TYPE_HW_CACHE or PERF_TYPE_HARDWARE event
+	 */
+	Counter(uint32_t type, uint64_t config) : fd(-1) {
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~Counter() {
+#ifdef __linux__
+		if (fd >= 0) close(fd);
+#endif
+	}
+
+	bool available() const { return fd >= 0; }
+
+	void start() {
+#ifdef __linux__
+		if (fd < 0) return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	/**
+	 * @return the number of events since start()
+	 */
+	uint64_t stop() {
+		uint64_t count = 0;
+#ifdef __linux__
+		if (fd < 0) return 0;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+		return count;
+	}
+
+private:
+	long fd;
+};
+
+struct Measure {
+	double seconds;
+	int successes;
+	uint64_t cacheMisses, l1Misses;
+	long probes, refuted;
+	std::vector<Array3D<int>> worlds;
+};
+
+static Measure Time(Model &model, int runs, Counter &cacheMisses, Counter &l1Misses) {
+	Measure measure = {0, 0, 0, 0, 0, 0, std::vector<Array3D<int>>()};
+	for (int seed = 0; seed < runs; seed++) {
+		auto start = std::chrono::steady_clock::now();
+		cacheMisses.start();
+		l1Misses.start();
+		if (model.Run(seed)) measure.successes++;
+		measure.l1Misses += l1Misses.stop();
+		measure.cacheMisses += cacheMisses.stop();
+		measure.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		measure.probes += model.getStatistics().probes;
+		measure.refuted += model.getStatistics().refuted;
+		measure.worlds.push_back(model.getObserved());
+	}
+	return measure;
+}
+
+/**
+ * @return true if every pair of neighboring blocks of the world is allowed by the propagator of the tileset
+ */
+static bool Adjacent(const Tileset &tileset, const Array3D<int> &world, int X, int Y, int Z, bool periodic) {
+	for (int x = 0; x < X; x++)
+		for (int y = 0; y < Y; y++)
+			for (int z = 0; z < Z; z++)
+				for (int d = 0; d < 6; d++) {
+					int nx = x + Grid::dx[d], ny = y + Grid::dy[d], nz = z + Grid::dz[d];
+					if (periodic) {
+						nx = (nx + X) % X;
+						ny = (ny + Y) % Y;
+						nz = (nz + Z) % Z;
+					} else if (nx < 0 || nx >= X || ny < 0 || ny >= Y || nz < 0 || nz >= Z) continue;
+					if (!tileset.propagator.get(d, world.get(x, y, z), world.get(nx, ny, nz))) return false;
+				}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	std::string name = argc > 1 ? argv[1] : "World2";
+	int X = argc > 2 ? atoi(argv[2]) : 24, Y = argc > 3 ? atoi(argv[3]) : 24, Z = argc > 4 ? atoi(argv[4]) : 8;
+	int runs = argc > 5 ? atoi(argv[5]) : 50;
+	int backtrack = argc > 6 ? atoi(argv[6]) : 1000;
+	bool periodic = argc > 7 && atoi(argv[7]) != 0;
+	bool counters = argc > 8 && atoi(argv[8]) != 0;
+	int lookahead = argc > 9 ? atoi(argv[9]) : 0, candidates = argc > 10 ? atoi(argv[10]) : 4;
+
+	// the budgets of the attempts a runner hands out must all be valid step counts, or unlimited
+	RestartPolicy policies[2] = {RestartPolicy(RestartPolicy::Geometric, 100, 2), RestartPolicy(RestartPolicy::Luby, 100)};
+	for (int k = 0; k < 2; k++)
+		for (int attempt = 0; attempt < 1000; attempt++) {
+			double budget = policies[k].budget(attempt);
+			if (!(budget >= 0 && budget < double(LONG_MAX))) {
+				std::cout << "Restarts: invalid budget " << budget << " for the attempt " << attempt << std::endl;
+				return 1;
+			}
+		}
+	if (policies[0].budget(999) != 0) {
+		std::cout << "Restarts: the overflowing geometric budget is not unlimited" << std::endl;
+		return 1;
+	}
+
+	std::shared_ptr<const Tileset> tileset = Tileset::Load(name, "ground");
+	std::cout << name << ": " << tileset->T << " tiles, " << X << "x" << Y << "x" << Z << " blocks, "
+			  << runs << " runs" << std::endl;
+
+#ifdef __linux__
+	Counter cacheMisses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	Counter l1Misses(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+										 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+	Counter cacheMisses(0, 0), l1Misses(0, 0);
+#endif
+	if (!cacheMisses.available())
+		std::cout << "Hardware cache counters unavailable (perf_event_open), only timing" << std::endl;
+
+	const int configurations = 3;
+	const char *names[configurations] = {"CellMajor XMajor", "CellMajor Morton", "TileMajor XMajor"};
+	Wave::Layout layouts[configurations] = {Wave::CellMajor, Wave::CellMajor, Wave::TileMajor};
+	Grid::Order orders[configurations] = {Grid::XMajor, Grid::Morton, Grid::XMajor};
+	Measure measures[configurations];
+	for (int k = 0; k < configurations; k++) {
+		Model model(tileset, X, Y, Z, periodic, layouts[k], orders[k]);
+		model.setBacktrackBudget(backtrack);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		measures[k] = Time(model, runs, cacheMisses, l1Misses);
+		std::cout << names[k] << ": " << measures[k].successes << "/" << runs << " generated, "
+				  << 1000 * measures[k].seconds / runs << " ms per run";
+		if (cacheMisses.available())
+			std::cout << ", " << measures[k].cacheMisses / runs << " cache misses and "
+					  << measures[k].l1Misses / runs << " L1 data read misses per run";
+		std::cout << std::endl;
+	}
+
+	// the draws are keyed by the coordinates of the cells, and every propagation reaches the same fixpoint,
+	// so all the configurations must generate the same worlds
+	for (int k = 1; k < configurations; k++)
+		for (int seed = 0; seed < runs; seed++) {
+			const Array3D<int> &a = measures[0].worlds[seed], &b = measures[k].worlds[seed];
+			if (!std::equal(a.begin(), a.end(), b.begin())) {
+				std::cout << names[k] << ": different world for the seed " << seed << std::endl;
+				return 1;
+			}
+		}
+
+	const char *heuristicNames[3] = {"MinEntropy", "MinRemainingValues", "Scanline"};
+	Model::Heuristic heuristics[3] = {Model::MinEntropy, Model::MinRemainingValues, Model::Scanline};
+	for (int k = 0; k < 3; k++) {
+		Model model(tileset, X, Y, Z, periodic);
+		model.setBacktrackBudget(backtrack);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		model.setHeuristic(heuristics[k]);
+		Measure measure = Time(model, runs, cacheMisses, l1Misses);
+		std::cout << heuristicNames[k] << ": " << measure.successes << "/" << runs << " generated, "
+				  << 1000 * measure.seconds / runs << " ms per run, " << runs / measure.seconds << " runs and "
+				  << measure.successes / measure.seconds << " worlds per second" << std::endl;
+	}
+
+	// nogoods learned from failed runs, without backtracking so that runs fail: each must still contradict
+	{
+		Model model(tileset, X, Y, Z, periodic);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		model.setNogoodLearning(true);
+		int learned = 0;
+		for (int seed = 0; seed < runs; seed++) {
+			model.Run(seed);
+			learned += model.getStatistics().learned;
+		}
+		int unsound = model.CheckNogoods();
+		std::cout << "Nogoods: " << learned << " learned in " << runs << " runs, " << unsound << " not contradicting" << std::endl;
+		if (unsound) return 1;
+	}
+
+	// regions of 4x4 columns generated again in a world: only the region and its border are visited, and the world stays valid
+	{
+		Model model(tileset, X, Y, Z, periodic);
+		model.setBacktrackBudget(backtrack);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		int seed = 0;
+		while (seed < runs && !model.Run(seed)) seed++;
+		if (seed < runs) {
+			int size = std::min(4, std::min(X, Y)), regenerated = 0;
+			double seconds = 0;
+			size_t blocks = 0;
+			Model::Delta delta, again;
+			for (int k = 0; k < runs; k++) {
+				// halfway, the other propagation takes over the world
+				if (k == runs / 2) model.setPropagation(counters ? Model::Bitsets : Model::SupportCounters);
+				int x = k * 7 % (X - size + 1), y = k * 5 % (Y - size + 1);
+				Model::Region region = {x, y, 0, x + size, y + size, Z};
+				Array3D<int> before = model.getObserved();
+				bool generated = model.Regenerate(region, runs + k, delta);
+				if (generated) regenerated++;
+				seconds += model.getStatistics().seconds;
+				blocks += delta.blocks.size();
+
+				// the blocks outside of the region are kept, and the delta is the difference of the blocks
+				const Array3D<int> &after = model.getObserved();
+				size_t changed = 0, removed = 0, added = 0;
+				bool valid = generated || delta.blocks.empty();
+				for (int bx = 0; bx < X; bx++)
+					for (int by = 0; by < Y; by++)
+						for (int bz = 0; bz < Z; bz++)
+							if (before.get(bx, by, bz) != after.get(bx, by, bz)) {
+								changed++;
+								valid = valid && bx >= region.x0 && bx < region.x1 && by >= region.y0 && by < region.y1;
+							}
+				for (const Model::Delta::Block &block : delta.blocks) {
+					valid = valid && block.before == before.get(block.x, block.y, block.z) &&
+							block.after == after.get(block.x, block.y, block.z);
+					removed += tileset->voxeltiles[block.before].size();
+					added += tileset->voxeltiles[block.after].size();
+				}
+				valid = valid && changed == delta.blocks.size() && removed == delta.removed.size() &&
+						added == delta.added.size();
+				valid = valid && Adjacent(*tileset, after, X, Y, Z, periodic);
+
+				// the same seed gives the same region again, whatever it held before
+				if (valid && generated) {
+					Array3D<int> first = after;
+					valid = model.Regenerate(region, runs + k, again) && again.blocks.empty() &&
+							std::equal(first.begin(), first.end(), model.getObserved().begin());
+				}
+				if (!valid) {
+					std::cout << "Regions: wrong regeneration of the region at (" << x << ", " << y << ") with the seed "
+							  << runs + k << std::endl;
+					return 1;
+				}
+			}
+			std::cout << "Regions of " << size << "x" << size << " blocks: " << regenerated << "/" << runs << " regenerated, "
+					  << 1000 * seconds / runs << " ms per region, " << double(blocks) / runs << " blocks changed per region"
+					  << std::endl;
+		}
+	}
+
+	// a pin added after the run, like the ones before it, holds in the regions regenerated over it
+	if (!tileset->find("grass").empty() && X >= 12 && Y >= 12 && Z >= 3) {
+		Model model(tileset, X, Y, Z, periodic);
+		model.setBacktrackBudget(backtrack);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		int grass = tileset->find("grass")[0];
+		model.addPin(2, 2, Z - 2, "grass", 4, 4, 1);
+		int seed = 0;
+		while (seed < runs && !model.Run(seed)) seed++;
+		model.addPin(2, Y - 6, Z - 2, "grass", 4, 4, 1);
+		int regenerated = 0;
+		Model::Delta delta;
+		for (int k = 0; seed < runs && k < runs; k++) {
+			int y = k % 2 ? Y - 6 : 2;
+			Model::Region region = {0, y - 2, 0, 8, y + 6, Z};
+			bool generated = model.Regenerate(region, runs + k, delta);
+			regenerated += generated;
+			for (int x = 2; x < 6; x++)
+				for (int py = 2; py < 6; py++)
+					if (model.getObserved().get(x, py, Z - 2) != grass ||
+						(generated && model.getObserved().get(x, y + py - 2, Z - 2) != grass)) {
+						std::cout << "Pins: the region at y = " << y << " with the seed " << runs + k
+								  << " does not hold its pins" << std::endl;
+						return 1;
+					}
+		}
+		std::cout << "Pins: " << regenerated << "/" << runs << " regions regenerated over pins" << std::endl;
+	}
+
+	if (lookahead > 0) {
+		Model model(tileset, X, Y, Z, periodic);
+		model.setBacktrackBudget(backtrack);
+		if (counters) model.setPropagation(Model::SupportCounters);
+		model.setLookahead(lookahead, candidates);
+		Measure measure = Time(model, runs, cacheMisses, l1Misses);
+		std::cout << "Lookahead of radius " << lookahead << ", " << candidates << " candidates: " << measure.successes << "/"
+				  << runs << " generated, " << 1000 * measure.seconds / runs << " ms per run, "
+				  << double(measure.probes) / runs << " tiles tried and " << double(measure.refuted) / runs << " refuted per run";
+		if (measure.successes) std::cout << ", " << 1000 * measure.seconds / measure.successes << " ms per world";
+		std::cout << std::endl;
+
+		// failed runs per generated world, each of them a restart with another seed
+		if (measures[0].successes && measure.successes) {
+			double without = double(runs - measures[0].successes) / measures[0].successes;
+			double with = double(runs - measure.successes) / measure.successes;
+			std::cout << "Restarts per world: " << without << " without the lookahead, " << with << " with it, "
+					  << without - with << " saved" << std::endl;
+		} else if (measure.successes)
+			std::cout << "Restarts per world: no world without the lookahead, " << double(runs - measure.successes) / measure.successes
+					  << " with it" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_ENTROPY_QUEUE_H
+#define WFCTILEMAPGENERATION_ENTROPY_QUEUE_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Indexed binary min-heap of cells, ordered by a key (their entropy).
+ * The position of every cell in the heap is tracked, so the key of a cell
+ * can be changed or the cell removed in O(log n).
+ */
+class EntropyQueue {
+public:
+	EntropyQueue() {}
+
+	/**
+	 * Empty the queue and make it able to hold the cells [0, cells)
+	 */
+	void reset(size_t cells) {
+		heap.clear();
+		position.assign(cells, -1);
+		keys.assign(cells, 0);
+	}
+
+	bool empty() const { return heap.empty(); }
+
+	size_t size() const { return heap.size(); }
+
+	/**
+	 * @return the cell with the lowest key
+	 */
+	int top() const { return heap[0]; }
+
+	bool contains(int cell) const { return position[cell] >= 0; }
+
+	double key(int cell) const { return keys[cell]; }
+
+	/**
+	 * Insert the cell with the given key, or change its key if it is already queued
+	 */
+	void update(int cell, double key) {
+		keys[cell] = key;
+		if (position[cell] < 0) {
+			position[cell] = heap.size();
+			heap.push_back(cell);
+		}
+		siftDown(siftUp(position[cell]));
+	}
+
+	/**
+	 * Insert a cell which is not queued yet, without restoring the heap order:
+	 * heapify() must be called after a batch of appends
+	 */
+	void append(int cell, double key) {
+		keys[cell] = key;
+		position[cell] = heap.size();
+		heap.push_back(cell);
+	}
+
+	/**
+	 * Restore the heap order in O(n), after appends
+	 */
+	void heapify() {
+		for (int p = int(heap.size()) / 2 - 1; p >= 0; p--)
+			siftDown(p);
+	}
+
+	/**
+	 * Remove the cell from the queue, if it is queued
+	 */
+	void remove(int cell) {
+		int p = position[cell];
+		if (p < 0) return;
+		int last = heap.back();
+		heap.pop_back();
+		position[cell] = -1;
+		if (last == cell) return;
+		heap[p] = last;
+		position[last] = p;
+		siftDown(siftUp(p));
+	}
+
+private:
+	std::vector<int> heap;
+	std::vector<int> position;
+	std::vector<double> keys;
+
+	void swap(int a, int b) {
+		int ca = heap[a], cb = heap[b];
+		heap[a] = cb;
+		heap[b] = ca;
+		position[cb] = a;
+		position[ca] = b;
+	}
+
+	int siftUp(int p) {
+		while (p > 0) {
+			int parent = (p - 1) / 2;
+			if (keys[heap[parent]] <= keys[heap[p]]) break;
+			swap(p, parent);
+			p = parent;
+		}
+		return p;
+	}
+
+	int siftDown(int p) {
+		int n = heap.size();
+		while (true) {
+			int l = 2 * p + 1, r = l + 1, m = p;
+			if (l < n && keys[heap[l]] < keys[heap[m]]) m = l;
+			if (r < n && keys[heap[r]] < keys[heap[m]]) m = r;
+			if (m == p) return p;
+			swap(p, m);
+			p = m;
+		}
+	}
+};
+
+#endif //WFCTILEMAPGENERATION_ENTROPY_QUEUE_H
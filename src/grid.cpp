@@ -0,0 +1,83 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "grid.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+const int Grid::dx[6] = {-1, 0, 1, 0, 0, 0};
+const int Grid::dy[6] = {0, 1, 0, -1, 0, 0};
+const int Grid::dz[6] = {0, 0, 0, 0, 1, -1};
+const int Grid::opposite[6] = {2, 3, 0, 1, 5, 4};
+
+std::shared_ptr<const Grid> Grid::Get(int FMX, int FMY, int FMZ, bool periodic, Order order) {
+	typedef std::tuple<int, int, int, bool, Order> Key;
+	static std::mutex mutex;
+	static std::map<Key, std::weak_ptr<const Grid>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Key key(FMX, FMY, FMZ, periodic, order);
+	std::shared_ptr<const Grid> grid = cache[key].lock();
+	if (grid) return grid;
+	// forget the grids no model uses any more
+	for (std::map<Key, std::weak_ptr<const Grid>>::iterator entry = cache.begin(); entry != cache.end();)
+		if (entry->second.expired()) entry = cache.erase(entry);
+		else ++entry;
+
+	grid = std::shared_ptr<const Grid>(new Grid(FMX, FMY, FMZ, periodic, order));
+	cache[key] = grid;
+	return grid;
+}
+
+Grid::Grid(int FMX, int FMY, int FMZ, bool periodic, Order order) :
+		FMX(FMX), FMY(FMY), FMZ(FMZ), periodic(periodic), order(order) {
+	const int size[3] = {FMX, FMY, FMZ};
+
+	// cells sorted by their key in the order: their rank is their index
+	std::vector<std::pair<uint64_t, int>> keys(cells());
+	for (int x = 0; x < FMX; x++)
+		for (int y = 0; y < FMY; y++)
+			for (int z = 0; z < FMZ; z++) {
+				int k = (x * FMY + y) * FMZ + z;
+				keys[k] = std::make_pair(order == Morton ? MortonCode(x, y, z) : uint64_t(k), k);
+			}
+	std::sort(keys.begin(), keys.end());
+	indices = std::vector<int>(cells());
+	positions = std::vector<int>(cells() * 3);
+	for (int i = 0; i < cells(); i++) {
+		int k = keys[i].second;
+		indices[k] = i;
+		positions[i * 3] = k / (FMY * FMZ);
+		positions[i * 3 + 1] = (k / FMZ) % FMY;
+		positions[i * 3 + 2] = k % FMZ;
+	}
+
+	table = std::vector<int>(cells() * 6, -1);
+	for (int i = 0; i < cells(); i++)
+		for (int d = 0; d < 6; d++) {
+			const int *p = position(i);
+			int n[3] = {p[0] + dx[d], p[1] + dy[d], p[2] + dz[d]};
+			bool inside = true;
+			for (int k = 0; k < 3; k++)
+				if (n[k] < 0 || n[k] >= size[k]) {
+					inside = false;
+					n[k] = (n[k] + size[k]) % size[k];
+				}
+			if (inside || periodic)
+				table[i * 6 + d] = index(n[0], n[1], n[2]);
+		}
+}
+
+uint64_t Grid::MortonCode(uint32_t x, uint32_t y, uint32_t z) {
+	uint64_t code = 0;
+	for (int b = 0; b < 21; b++)
+		code |= (uint64_t((x >> b) & 1) << (3 * b + 2)) | (uint64_t((y >> b) & 1) << (3 * b + 1)) | (uint64_t((z >> b) & 1) << (3 * b));
+	return code;
+}
@@ -0,0 +1,92 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_GRID_H
+#define WFCTILEMAPGENERATION_GRID_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Shape of the FMX x FMY x FMZ grid of a model, and the order of its cells in memory:
+ * every per-cell array of the model (wave, counters, entropy sums) is indexed by the cell index of the grid.
+ * The neighbor of every cell in every direction is precomputed, so finding it is a single load;
+ * the tables are built once per dimensions, periodicity and order and shared by every model of this shape.
+ *
+ * Directions: 0: -x, 1: +y, 2: +x, 3: -y, 4: +z, 5: -z
+ */
+class Grid {
+public:
+	/**
+	 * Order of the cells in memory
+	 * XMajor: the x-major order of Array3D, neighbors in x are FMY * FMZ cells apart
+	 * Morton: Z-order curve (bits of x, y, z interleaved), compacted to the cells of the grid,
+	 * so the neighbors of a cell in every direction are mostly near it in memory
+	 */
+	enum Order {
+		XMajor, Morton
+	};
+
+	const int FMX, FMY, FMZ;
+	const bool periodic;
+	const Order order;
+
+	/** Offset of the neighbor in each direction */
+	static const int dx[6], dy[6], dz[6];
+
+	/** opposite[d]: direction from the neighbor in direction d back to the cell */
+	static const int opposite[6];
+
+	/**
+	 * @return the shared grid of these dimensions and periodicity, built on first use
+	 */
+	static std::shared_ptr<const Grid> Get(int FMX, int FMY, int FMZ, bool periodic, Order order = XMajor);
+
+	int cells() const { return FMX * FMY * FMZ; }
+
+	/**
+	 * @return the index of the cell (x, y, z)
+	 */
+	int index(int x, int y, int z) const { return indices[(x * FMY + y) * FMZ + z]; }
+
+	/**
+	 * @return the index of the k-th cell in x-major order, the cell (x, y, z) with k = (x * FMY + y) * FMZ + z
+	 */
+	int indexAt(int k) const { return indices[k]; }
+
+	/**
+	 * @return the coordinates (x, y, z) of the cell i
+	 */
+	const int *position(int i) const { return &positions[i * 3]; }
+
+	/**
+	 * @return the index of the neighbor of the cell i in direction d, -1 if there is none (non periodic border)
+	 */
+	int neighbor(int i, int d) const { return table[i * 6 + d]; }
+
+	/**
+	 * @return the 6 neighbors of the cell i, by direction
+	 */
+	const int *neighbors(int i) const { return &table[i * 6]; }
+
+private:
+	/** table[i * 6 + d]: neighbor of the cell i in direction d */
+	std::vector<int> table;
+
+	/** indices[(x * FMY + y) * FMZ + z]: index of the cell (x, y, z), positions[i * 3 + k]: its coordinates */
+	std::vector<int> indices, positions;
+
+	Grid(int FMX, int FMY, int FMZ, bool periodic, Order order);
+
+	/**
+	 * @return the Morton code of (x, y, z), for coordinates below 2^21
+	 */
+	static uint64_t MortonCode(uint32_t x, uint32_t y, uint32_t z);
+};
+
+#endif //WFCTILEMAPGENERATION_GRID_H
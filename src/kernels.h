@@ -0,0 +1,122 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_KERNELS_H
+#define WFCTILEMAPGENERATION_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Bitset kernels of the propagation, on sets of tiles stored as W words of 64 bits,
+ * and on bit-planes of cells.
+ * AVX2 and SSE2 versions are used when the compiler targets them (see the WFC_NATIVE
+ * CMake option), with a scalar fallback otherwise.
+ */
+
+/**
+ * acc |= src, on W words
+ */
+inline void OrInto(uint64_t *acc, const uint64_t *src, size_t W) {
+	size_t w = 0;
+#if defined(__AVX2__)
+	for (; w + 4 <= W; w += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (acc + w));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (src + w));
+		_mm256_storeu_si256((__m256i *) (acc + w), _mm256_or_si256(a, b));
+	}
+#endif
+#if defined(__SSE2__)
+	for (; w + 2 <= W; w += 2) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (acc + w));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + w));
+		_mm_storeu_si128((__m128i *) (acc + w), _mm_or_si128(a, b));
+	}
+#endif
+	for (; w < W; w++) acc[w] |= src[w];
+}
+
+/**
+ * acc = OR of the masks of every tile t set in domain, the mask of t being masks[t * W, t * W + W)
+ * @tparam FixedW the number of words W when known at compile time, 0 to use dynamicW
+ * @param T number of tiles
+ * @param dynamicW the number of words, when FixedW is 0
+ */
+template<size_t FixedW>
+inline void UnionOfMasks(uint64_t *acc, const uint64_t *masks, const uint64_t *domain, size_t T, size_t dynamicW) {
+	const size_t W = FixedW ? FixedW : dynamicW;
+	for (size_t w = 0; w < W; w++) acc[w] = 0;
+
+#if defined(__AVX2__)
+	// one word per tile: when most tiles are set, select the masks of 4 tiles at a time without branches
+	if (W == 1 && 2 * size_t(__builtin_popcountll(domain[0])) > T) {
+		__m256i all = _mm256_set1_epi64x(domain[0]), one = _mm256_set1_epi64x(1), zero = _mm256_setzero_si256();
+		__m256i shifts = _mm256_setr_epi64x(0, 1, 2, 3), four = _mm256_set1_epi64x(4);
+		__m256i sum = zero;
+		size_t t = 0;
+		for (; t + 4 <= T; t += 4) {
+			__m256i selected = _mm256_sub_epi64(zero, _mm256_and_si256(_mm256_srlv_epi64(all, shifts), one));
+			sum = _mm256_or_si256(sum, _mm256_and_si256(selected, _mm256_loadu_si256((const __m256i *) (masks + t))));
+			shifts = _mm256_add_epi64(shifts, four);
+		}
+		__m128i half = _mm_or_si128(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		uint64_t result = uint64_t(_mm_cvtsi128_si64(half)) | uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half)));
+		for (; t < T; t++)
+			if ((domain[0] >> t) & 1) result |= masks[t];
+		acc[0] = result;
+		return;
+	}
+#else
+	(void) T;
+#endif
+
+	for (size_t w = 0; w < W; w++)
+		for (uint64_t bits = domain[w]; bits; bits &= bits - 1) {
+			size_t t = w * 64 + __builtin_ctzll(bits);
+			if (W == 1) acc[0] |= masks[t];
+			else OrInto(acc, masks + t * W, W);
+		}
+}
+
+/**
+ * Word w of the bit string src of `words` words shifted by q * 64 + r bits (see ShiftInto),
+ * the bits out of src reading as 0
+ */
+inline uint64_t ShiftedWord(const uint64_t *src, size_t words, ptrdiff_t w, ptrdiff_t q, int r) {
+	ptrdiff_t s = w + q;
+	uint64_t low = s >= 0 && s < ptrdiff_t(words) ? src[s] : 0;
+	uint64_t high = s + 1 >= 0 && s + 1 < ptrdiff_t(words) ? src[s + 1] : 0;
+	return r ? (low >> r) | (high << (64 - r)) : low;
+}
+
+/**
+ * dst[w] = src shifted by offset bits, for the words w in [from, to): bit i of dst is the bit i + offset of src,
+ * the bits out of the `words` words of src reading as 0
+ */
+inline void ShiftInto(uint64_t *dst, const uint64_t *src, size_t words, size_t from, size_t to, ptrdiff_t offset) {
+	// offset = q * 64 + r with 0 <= r < 64
+	ptrdiff_t q = offset >= 0 ? offset / 64 : -((63 - offset) / 64);
+	int r = int(offset - q * 64);
+
+	// words whose two source words are in src do not need the bounds checks
+	ptrdiff_t innerFrom = std::min(std::max(-q, ptrdiff_t(from)), ptrdiff_t(to));
+	ptrdiff_t innerTo = std::max(std::min(ptrdiff_t(words) - 1 - q, ptrdiff_t(to)), innerFrom);
+	ptrdiff_t w = from;
+	for (; w < innerFrom; w++) dst[w] = ShiftedWord(src, words, w, q, r);
+	if (r)
+		for (; w < innerTo; w++) dst[w] = (src[w + q] >> r) | (src[w + q + 1] << (64 - r));
+	else
+		for (; w < innerTo; w++) dst[w] = src[w + q];
+	for (; w < ptrdiff_t(to); w++) dst[w] = ShiftedWord(src, words, w, q, r);
+}
+
+#endif //WFCTILEMAPGENERATION_KERNELS_H
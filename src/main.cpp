@@ -6,7 +6,9 @@
  */
 
 #include <rendering/World_Viewer.h>
+#include <pugixml.hpp>
 #include "model.h"
+#include "parallel.h"
 #include "voxels.h"
 
 int main(int argc, char *argv[]) {
@@ -19,7 +21,7 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
-	srand(time(NULL));
+	Random random(time(NULL));
 
 	std::string filename;
 
@@ -35,22 +37,47 @@ int main(int argc, char *argv[]) {
 			std::cout << "Sample: " << name << std::endl;
 
 
+			std::string hugePages = sample.attribute("hugepages").as_string("transparent");
+			Memory::setHugePages(hugePages == "none" ? Memory::None : hugePages == "explicit" ? Memory::Explicit : Memory::Transparent);
+			Wave::Layout layout = std::string(sample.attribute("layout").as_string()) == "TileMajor" ? Wave::TileMajor : Wave::CellMajor;
+			Grid::Order order = std::string(sample.attribute("order").as_string()) == "Morton" ? Grid::Morton : Grid::XMajor;
 			Model model = Model(name, sample.attribute("X").as_int(), sample.attribute("Y").as_int(),
 								sample.attribute("Z").as_int(),
-								sample.attribute("periodic").as_bool(), sample.attribute("ground").as_string());
-
+								sample.attribute("periodic").as_bool(), sample.attribute("ground").as_string(), layout, order);
+			model.setBacktrackBudget(sample.attribute("backtrack").as_int(0));
+			std::string heuristic = sample.attribute("heuristic").as_string();
+			model.setHeuristic(heuristic == "Scanline" ? Model::Scanline :
+							   heuristic == "MinRemainingValues" ? Model::MinRemainingValues : Model::MinEntropy);
+			model.setLookahead(sample.attribute("lookahead").as_int(0), sample.attribute("lookaheadCandidates").as_int(4));
+			model.setNogoodLearning(sample.attribute("learning").as_bool(false), sample.attribute("learningLength").as_int(12));
+			for (pugi::xml_node pin = sample.child("pin"); pin; pin = pin.next_sibling("pin"))
+				model.addPin(pin.attribute("x").as_int(), pin.attribute("y").as_int(), pin.attribute("z").as_int(),
+							 pin.attribute("tile").as_string(), pin.attribute("sizeX").as_int(1),
+							 pin.attribute("sizeY").as_int(1), pin.attribute("sizeZ").as_int(1));
+
+
+			ParallelRunner runner(model, sample.attribute("threads").as_uint(0));
+			// without a base, an attempt counted in steps gets as many steps as the world has blocks
+			std::string restartUnit = sample.attribute("restartUnit").as_string();
+			double restartBase = restartUnit == "seconds" ? 0 : sample.attribute("X").as_double() *
+					sample.attribute("Y").as_double() * sample.attribute("Z").as_double();
+			runner.setRestartPolicy(RestartPolicy::Parse(sample.attribute("restart").as_string(),
+														 sample.attribute("restartBase").as_double(restartBase),
+														 sample.attribute("restartFactor").as_double(2), restartUnit));
 
 			for (int i = 0; i < sample.attribute("screenshots").as_int(); i++) {
-				for (int k = 0; k < 1000; k++) {
-
-					int seed = rand();
-					bool finished = model.Run(seed);
-					filename = "test_" + std::to_string(seed) + ".vox";
-					if (finished) {
-						std::cout << "Finished ! Generated vox file " << filename << std::endl;
-						model.saveVoxelOutput(filename);
-                        break;
-					}
+				std::vector<int> seeds(1000);
+				for (size_t k = 0; k < seeds.size(); k++)
+					seeds[k] = int(random.next() >> 33);
+
+				GenerationResult result = runner.Run(seeds);
+				std::cout << result.statistics.attempts << " attempts (" << result.statistics.failures << " contradictions, "
+						  << result.statistics.aborted << " aborted), " << result.statistics.steps << " steps, "
+						  << result.statistics.learned << " nogoods learned" << std::endl;
+				if (result.success) {
+					filename = "world_" + std::to_string(result.seed) + ".vox";
+					std::cout << "Finished ! Generated vox file " << filename << std::endl;
+					model.saveVoxelOutput(filename, result.observed);
 				}
 			}
 
@@ -0,0 +1,105 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "memory.h"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+	Memory::HugePages hugePages = Memory::Transparent;
+
+	/** Released large blocks by size, at most maxFreeBlocks of them */
+	std::multimap<size_t, void *> freeBlocks;
+	const size_t maxFreeBlocks = 16;
+	std::mutex mutex;
+
+	size_t MappedSize(size_t bytes) {
+		return (bytes + Memory::hugePageSize - 1) / Memory::hugePageSize * Memory::hugePageSize;
+	}
+
+	void *Map(size_t bytes) {
+#ifdef __linux__
+		size_t size = MappedSize(bytes);
+		void *block = MAP_FAILED;
+		if (hugePages == Memory::Explicit)
+			block = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (block == MAP_FAILED) {
+			block = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (block == MAP_FAILED) return 0;
+#ifdef MADV_HUGEPAGE
+			if (hugePages != Memory::None) madvise(block, size, MADV_HUGEPAGE);
+#endif
+		}
+		return block;
+#else
+		return 0;
+#endif
+	}
+}
+
+void Memory::setHugePages(HugePages value) {
+	std::lock_guard<std::mutex> lock(mutex);
+	hugePages = value;
+}
+
+Memory::HugePages Memory::getHugePages() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return hugePages;
+}
+
+void *Memory::Allocate(size_t bytes) {
+	if (bytes == 0) bytes = 1;
+	void *block = 0;
+#ifdef __linux__
+	if (bytes >= hugePageSize) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::multimap<size_t, void *>::iterator reused = freeBlocks.find(MappedSize(bytes));
+		if (reused != freeBlocks.end()) {
+			block = reused->second;
+			freeBlocks.erase(reused);
+			return block;
+		}
+		block = Map(bytes);
+		if (!block) throw std::bad_alloc();
+		return block;
+	}
+#endif
+#ifdef _WIN32
+	block = _aligned_malloc(bytes, alignment);
+	if (!block) throw std::bad_alloc();
+#else
+	if (posix_memalign(&block, alignment, bytes) != 0) throw std::bad_alloc();
+#endif
+	return block;
+}
+
+void Memory::Free(void *block, size_t bytes) {
+	if (!block) return;
+	if (bytes == 0) bytes = 1;
+#ifdef __linux__
+	if (bytes >= hugePageSize) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (freeBlocks.size() < maxFreeBlocks) freeBlocks.insert(std::make_pair(MappedSize(bytes), block));
+		else munmap(block, MappedSize(bytes));
+		return;
+	}
+#endif
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
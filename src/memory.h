@@ -0,0 +1,83 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_MEMORY_H
+#define WFCTILEMAPGENERATION_MEMORY_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Allocation of the large arrays of the solver: every block is aligned on a cache line (64 bytes),
+ * so SIMD loads of a row never straddle two lines, and blocks of at least hugePageSize bytes
+ * are mapped directly, backed by huge pages where the system allows it.
+ * Released large blocks are kept for the next allocation of the same size, so the arrays of
+ * models created and destroyed again and again (one per seed, one per thread) do not go back to the system.
+ */
+class Memory {
+public:
+	static const size_t alignment = 64;
+	static const size_t hugePageSize = 2 << 20;
+
+	/**
+	 * Backing of the blocks of at least hugePageSize bytes
+	 * None: regular pages
+	 * Transparent: regular mapping, advised to the kernel for transparent huge pages (the default)
+	 * Explicit: pages from the reserved huge pages pool (MAP_HUGETLB), or Transparent if the pool is empty
+	 */
+	enum HugePages {
+		None, Transparent, Explicit
+	};
+
+	static void setHugePages(HugePages hugePages);
+
+	static HugePages getHugePages();
+
+	/**
+	 * @return a block of bytes aligned on `alignment`, never null (throws std::bad_alloc)
+	 */
+	static void *Allocate(size_t bytes);
+
+	/**
+	 * Release a block returned by Allocate(bytes)
+	 */
+	static void Free(void *block, size_t bytes);
+};
+
+/**
+ * Standard allocator on Memory, for std::vector and the arrays of utils.h
+ */
+template<typename T>
+struct AlignedAllocator {
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind {
+		typedef AlignedAllocator<U> other;
+	};
+
+	AlignedAllocator() {}
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U> &) {}
+
+	T *allocate(size_t n) { return static_cast<T *>(Memory::Allocate(n * sizeof(T))); }
+
+	void deallocate(T *block, size_t n) { Memory::Free(block, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U> &) const { return true; }
+
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U> &) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+#endif //WFCTILEMAPGENERATION_MEMORY_H
@@ -6,388 +6,1006 @@
  */
 
 #include "model.h"
+#include "kernels.h"
 
-bool Model::Run(int seed) {
-	logT = std::log(T);
-	logProb = std::vector<double>(T, 0);
-	for (int t = 0; t < T; t++) logProb[t] = std::log(stationary[t]);
-	Clear();
-	std::mt19937 gen(seed);
-	std::uniform_real_distribution<double> dis(0.0, 1.0);
-	random = [&]() { return dis(gen); };
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <tuple>
 
-	int ite = 0;
-	while (true) {
-		ObserveStates result = Observe();
+bool Model::Run(int seed) {
+	return Run(seed, std::function<bool()>());
+}
 
-		if (result == True) return true;
-		else if (result == False) return false;
+bool Model::Run(int seed, std::function<bool()> cancelled) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Begin(seed);
+	statistics.status = Search(cancelled);
+	if (learning && statistics.status == Contradiction) Learn();
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return statistics.status == Success;
+}
 
-		while (Propagate());
-	}
+bool Model::Run(const Snapshot &snapshot, int seed) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Fork(snapshot, seed);
+	statistics.status = Search(std::function<bool()>());
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return statistics.status == Success;
 }
 
-Model::Model(std::string name, int FMX, int FMY, int FMZ, bool periodic, std::string groundName) {
-this->FMX = FMX;
-this->FMY = FMY;
-this->FMZ = FMZ;
-this->periodic = periodic;
-this->ground = -1;
-this->bounds = -1;
+void Model::Begin(int seed) {
+	random = Philox(seed);
+	Statistics none = {Running, 0, 0, 0, 0, 0, 0, 0, 0};
+	statistics = none;
+	refutedInRow = 0;
+	Region whole = {0, 0, 0, FMX, FMY, FMZ};
+	solving = whole;
+	complete = false;
 
-pugi::xml_document xdoc;
-std::string filename = "../" + name + "/data.xml";
-if (!xdoc.load_file(filename.c_str())) {
-std::cout << "Error during opening of samples.xml";
+	if (learning) SyncNogoods();
+	Clear();
+	decisions.clear();
+	conflict.clear();
+	backtracks = 0;
+	if (!pins.empty() && !pinned) {
+		// the first run after the pins changed propagates them, the next ones start from the result
+		ApplyPins(pins);
+		std::shared_ptr<InitialState> state = std::make_shared<InitialState>();
+		state->tileset = tileset;
+		state->grid = grid;
+		state->nogoods = initial->nogoods;
+		state->wave = wave;
+		if (propagation == SupportCounters) state->compatible = compatible;
+		state->sumsOfOnes = sumsOfOnes;
+		state->sumsOfWeights = sumsOfWeights;
+		state->sumsOfWeightLogWeights = sumsOfWeightLogWeights;
+		state->contradiction = pinsContradict;
+		pinned = state;
+		trail.clear();
+	}
 }
-pugi::xml_node xnode = xdoc.first_child();
 
-voxelsize = xnode.attribute("voxelsize").as_int();
+Model::Status Model::Search(std::function<bool()> cancelled) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeBudget));
 
-xnode = xnode.first_child();
+	while (true) {
+		if (cancelled && cancelled()) return Cancelled;
+		if (stepBudget > 0 && statistics.steps >= stepBudget) return Aborted;
+		if (timeBudget > 0 && std::chrono::steady_clock::now() >= deadline) return Aborted;
 
-std::vector<double> tempStationary;
-std::vector<std::array<int, 8>> action;
-std::map<std::string, int> firstOccurrence;
+		Status status = Step();
+		if (status != Running) return status;
+	}
+}
 
-for (pugi::xml_node xtile: xnode.children()) {
-std::string tilename = xtile.attribute("name").as_string();
-std::string sym = xtile.attribute("symmetry").as_string();
-std::function<int(int)> a, b;
+Model::Status Model::Step() {
+	if (initial->contradiction || pinsContradict) {
+		statistics.contradictions++;
+		return statistics.status = Contradiction;
+	}
 
-// Default sym
-int cardinality = 1;
-a = [](int i) { return i; };
-b = [](int i) { return i; };
+	ObserveStates result = Observe();
 
-if (!sym.compare("L")) {
-cardinality = 4;
-a = [](int i) { return (i + 1) % 4; };
-b = [](int i) { return i % 2 == 0 ? i + 1 : i - 1; };
-} else if (!sym.compare("T")) {
-cardinality = 4;
-a = [](int i) { return (i + 1) % 4; };
-b = [](int i) { return i % 2 == 0 ? i : 4 - i; };
-} else if (!sym.compare("I")) {
-cardinality = 2;
-a = [](int i) { return 1 - i; };
-b = [](int i) { return i; };
+	if (result == True) return statistics.status = Success;
+	if (result == False) {
+		statistics.contradictions++;
+		return statistics.status = Contradiction;
+	}
+
+	if (!PropagateNogoods()) {
+		statistics.contradictions++;
+		if (learning) conflict = decisions;
+		bool recovered = Backtrack();
+		statistics.backtracks = backtracks;
+		if (!recovered) return statistics.status = Contradiction;
+	}
+	return Running;
 }
 
-T = action.size();
-firstOccurrence[tilename] = T;
+Model::Snapshot Model::snapshot() const {
+	std::shared_ptr<Model> copy = std::make_shared<Model>(*this);
+	// forks start a trail of their own and make their own decisions
+	copy->trail.clear();
+	copy->decisions.clear();
+	copy->forkSource.reset();
+	return copy;
+}
 
-if (tilename.compare(groundName) == 0) {
-ground = T;
+void Model::Fork(const Snapshot &snapshot, int seed) {
+	if (snapshot->tileset != tileset || snapshot->grid != grid || snapshot->wave.getLayout() != wave.getLayout() ||
+		snapshot->propagation != propagation || snapshot->heuristic != heuristic)
+		Error("Cannot fork a snapshot of a model of another tileset, grid, layout, propagation or heuristic");
+
+	// undoing a removal costs about as much as copying the state of 16 cells, or of 4 with the support counters:
+	// a continuation which changed few cells is undone, otherwise the state is copied again
+	size_t cellsPerRemoval = propagation == SupportCounters ? 4 : 16;
+	if (forkSource == snapshot && trail.size() * cellsPerRemoval < wave.cells()) Undo(0);
+	else {
+		wave = snapshot->wave;
+		if (propagation == SupportCounters) compatible = snapshot->compatible;
+		sumsOfOnes = snapshot->sumsOfOnes;
+		sumsOfWeights = snapshot->sumsOfWeights;
+		sumsOfWeightLogWeights = snapshot->sumsOfWeightLogWeights;
+		noise = snapshot->noise;
+		queue = snapshot->queue;
+		scanCursor = snapshot->scanCursor;
+		trail.clear();
+		forkSource = snapshot;
+	}
+	stack.clear();
+	decidedCells.clear();
+	observations = snapshot->observations;
+	pinsContradict = snapshot->pinsContradict;
+	Region whole = {0, 0, 0, FMX, FMY, FMZ};
+	solving = whole;
+	complete = false;
+
+	random = Philox(seed);
+	Statistics none = {Running, 0, 0, 0, 0, 0, 0, 0, 0};
+	statistics = none;
+	refutedInRow = 0;
+	if (learning) SyncNogoods();
+	decisions.clear();
+	conflict.clear();
+	backtracks = 0;
 }
 
-if (tilename.compare("bounds") == 0) {
-bounds = T;
+void Model::setBacktrackBudget(int budget) {
+	backtrackBudget = budget;
 }
 
-for (int t = 0; t < cardinality; t++) {
-std::array<int, 8> map;
+void Model::setStepBudget(long steps) {
+	stepBudget = steps;
+}
 
-map[0] = t;
-map[1] = a(t);
-map[2] = a(a(t));
-map[3] = a(a(a(t)));
-map[4] = b(t);
-map[5] = b(a(t));
-map[6] = b(a(a(t)));
-map[7] = b(a(a(a(t))));
+void Model::setTimeBudget(double seconds) {
+	timeBudget = seconds;
+}
 
-for (int s = 0; s < 8; ++s) {
-map[s] += T;
+const Model::Statistics &Model::getStatistics() const {
+	return statistics;
 }
 
-action.push_back(map);
+void Model::setLookahead(int radius, int candidates) {
+	lookaheadRadius = radius;
+	lookaheadCandidates = candidates;
 }
-std::cout << "Opening: " << "../" << name << "/" << tilename << ".vox" << std::endl;
-std::vector<Voxel> voxeltile = ReadVox("../" + name + "/" + tilename + ".vox");
 
+bool Model::Lookahead(int i, int t) {
+	statistics.probes++;
+	size_t trailSize = trail.size();
+	lookaheadCentre = i;
+	for (int t2 = 0; t2 < T; t2++)
+		if (t2 != t && wave.get(i, t2))
+			Ban(i, t2);
+	bool consistent = PropagateNogoods();
+	lookaheadCentre = -1;
+	Undo(trailSize);
+	if (!consistent) statistics.refuted++;
+	return consistent;
+}
 
-tilenames.push_back(tilename + " 0");
-voxeltiles.push_back(voxeltile);
+bool Model::InLookahead(int i) const {
+	if (lookaheadCentre < 0) return true;
+	const int *position = grid->position(i), *centre = grid->position(lookaheadCentre);
+	return std::abs(position[0] - centre[0]) <= lookaheadRadius && std::abs(position[1] - centre[1]) <= lookaheadRadius &&
+		   std::abs(position[2] - centre[2]) <= lookaheadRadius;
+}
 
-for (int t = 1; t < cardinality; t++) {
-    tilenames.push_back("" + tilename + " " + std::to_string(t));
-    voxeltiles.push_back(rotateVoxels(voxeltiles.at(T + t - 1), voxelsize));
+void Model::setNogoodLearning(bool enabled, int maxLength) {
+	learning = enabled;
+	maxNogoodLength = maxLength;
 }
 
-for (int t = 0; t < cardinality; t++) {
-    double w = xtile.attribute("weight").as_double();
-    if (w == 0)
-    w = 1;
-    tempStationary.push_back(w);
+void Model::SyncNogoods() {
+	size_t from = nogoods.size();
+	initial->nogoods->copy(from, nogoods);
+	for (size_t k = from; k < nogoods.size(); k++)
+		for (size_t j = 0; j < nogoods[k].size(); j++)
+			watches[nogoods[k][j].first].push_back(k);
 }
 
+bool Model::PropagateNogoods() {
+	while (Propagate()) {
+		bool banned = false, contradiction = false;
+		while (!decidedCells.empty() && !contradiction) {
+			int i = decidedCells.back();
+			decidedCells.pop_back();
+			if (sumsOfOnes[i] != 1) continue;
+
+			for (size_t k = 0; k < watches[i].size() && !contradiction; k++) {
+				// the literal still open, if all the others hold; none if a literal is false or two are open
+				const Nogood &nogood = nogoods[watches[i][k]];
+				int open = -1;
+				bool satisfied = false;
+				for (size_t j = 0; j < nogood.size() && !satisfied; j++) {
+					int i2 = nogood[j].first, t2 = nogood[j].second;
+					if (!wave.get(i2, t2)) satisfied = true;
+					else if (sumsOfOnes[i2] > 1) {
+						if (open >= 0) satisfied = true;
+						open = j;
+					}
+				}
+				if (satisfied) continue;
+				if (open < 0) contradiction = true;
+				else {
+					Ban(nogood[open].first, nogood[open].second);
+					statistics.pruned++;
+					banned = true;
+				}
+			}
+		}
+		if (contradiction) {
+			// apply the removals already made, so that the trail can be undone
+			Propagate();
+			break;
+		}
+		if (!banned) return true;
+	}
+	decidedCells.clear();
+	return false;
 }
 
-T = action.size();
-stationary = tempStationary;
+void Model::Learn() {
+	// the trail starts from the pinned state: the contradictions found may need the pins
+	if (conflict.empty() || pinned) return;
+	int pruned = statistics.pruned;
+	Undo(0);
+
+	// the last decision made the contradiction: add the others from the nearest to it until it occurs again
+	const int *last = grid->position(conflict.back().cell);
+	std::vector<std::pair<int, int>> order;
+	for (size_t k = 0; k < conflict.size(); k++) {
+		const int *position = grid->position(conflict[k].cell);
+		int distance = std::abs(position[0] - last[0]) + std::abs(position[1] - last[1]) + std::abs(position[2] - last[2]);
+		order.push_back(std::make_pair(k + 1 == conflict.size() ? -1 : distance, int(k)));
+	}
+	std::sort(order.begin(), order.end());
+
+	Nogood nogood;
+	bool contradiction = false;
+	for (size_t k = 0; k < order.size() && int(nogood.size()) < maxNogoodLength && !contradiction; k++) {
+		const Decision &decision = conflict[order[k].second];
+		nogood.push_back(std::make_pair(decision.cell, decision.tile));
+		contradiction = !Assume(decision.cell, decision.tile);
+	}
+	Undo(0);
+
+	if (contradiction) {
+		// drop the decisions the contradiction does not need, the farthest first
+		for (int k = int(nogood.size()) - 1; k >= 0 && nogood.size() > 1; k--) {
+			Nogood smaller(nogood);
+			smaller.erase(smaller.begin() + k);
+			if (Refutes(smaller)) nogood.swap(smaller);
+		}
+
+		if (initial->nogoods->add(nogood)) {
+			statistics.learned++;
+			std::vector<Nogood> images = initial->nogoods->images(nogood);
+			for (size_t k = 0; k < images.size(); k++)
+				if (Refutes(images[k]) && initial->nogoods->add(images[k])) statistics.learned++;
+		}
+	}
+	statistics.pruned = pruned;
+}
 
-observed = Array3D<int>(FMX, FMY, FMZ, -1);
-propagator = Array3D<bool>(6, T, T, false);
-wave = Array4D<bool>(FMX, FMY, FMZ, T, false);
-changes = Array3D<bool>(FMX, FMY, FMZ, false);
+int Model::CheckNogoods() {
+	std::vector<Nogood> stored;
+	initial->nogoods->copy(0, stored);
 
+	// without learning, the propagation ignores the nogoods, which would otherwise refute themselves
+	bool enabled = learning;
+	learning = false;
+	Clear();
+	decisions.clear();
+	complete = false;
+	int unsound = 0;
+	for (size_t k = 0; k < stored.size(); k++)
+		if (!Refutes(stored[k])) unsound++;
+	learning = enabled;
+	return unsound;
+}
 
-for (pugi::xml_node xneighbor : xnode.next_sibling().children()) {
-std::string text = xneighbor.attribute("left").as_string();
-std::vector<std::string> left;
-boost::split(left, text, [](char c) { return c == ' '; });
-text = xneighbor.attribute("right").as_string();
-std::vector<std::string> right;
-boost::split(right, text, [](char c) { return c == ' '; });
+bool Model::Assume(int i, int t) {
+	if (!wave.get(i, t)) return false;
+	for (int t2 = 0; t2 < T; t2++)
+		if (t2 != t && wave.get(i, t2))
+			Ban(i, t2);
+	return PropagateNogoods();
+}
 
-int L = action[firstOccurrence[left[0]]][left.size() == 1 ? 0 : std::atoi(left[1].c_str())];
-int D = action[L][1];
-int R = action[firstOccurrence[right[0]]][right.size() == 1 ? 0 : std::atoi(right[1].c_str())];
-int U = action[R][1];
+bool Model::Refutes(const Nogood &nogood) {
+	bool contradiction = false;
+	for (size_t k = 0; k < nogood.size() && !contradiction; k++)
+		contradiction = !Assume(nogood[k].first, nogood[k].second);
+	Undo(0);
+	return contradiction;
+}
 
-if (strcmp(xneighbor.name(), "horizontal") == 0) {
-propagator.set(0, R, L, true);
-propagator.set(0, action[R][6], action[L][6], true);
-propagator.set(0, action[L][4], action[R][4], true);
-propagator.set(0, action[L][2], action[R][2], true);
+bool Model::Backtrack() {
+	while (!decisions.empty() && backtracks < backtrackBudget) {
+		backtracks++;
+		Decision decision = decisions.back();
+		decisions.pop_back();
 
-propagator.set(1, U, D, true);
-propagator.set(1, action[D][6], action[U][6], true);
-propagator.set(1, action[U][4], action[D][4], true);
-propagator.set(1, action[D][2], action[U][2], true);
-} else {
-for (int g = 0; g < 8; g++) {
-propagator.set(4, action[L][g], action[R][g], true);
-}
+		Undo(decision.trailSize);
+		Ban(decision.cell, decision.tile);
+		if (PropagateNogoods()) return true;
+		statistics.contradictions++;
+	}
+	return false;
 }
+
+void Model::Restore(int i, int t) {
+	wave.set(i, t, true);
+	sumsOfOnes[i] += 1;
+	sumsOfWeights[i] += tileset->stationary[t];
+	sumsOfWeightLogWeights[i] += tileset->weightLogWeights[t];
+	UpdateEntropy(i);
+
+	if (propagation != SupportCounters) return;
+	const int *neighbors = grid->neighbors(i);
+	for (int d = 0; d < 6; d++) {
+		int i2 = neighbors[Grid::opposite[d]];
+		if (i2 < 0) continue;
+
+		const std::vector<int> &tiles = tileset->supported[d * T + t];
+		for (size_t k = 0; k < tiles.size(); k++)
+			compatible[(i2 * T + tiles[k]) * 6 + d]++;
+	}
 }
 
-for (int t2 = 0; t2 < T; t2++)
-for (int t1 = 0; t1 < T; t1++) {
-propagator.set(2, t2, t1, propagator.get(0, t1, t2));
-propagator.set(3, t2, t1, propagator.get(1, t1, t2));
-propagator.set(5, t2, t1, propagator.get(4, t1, t2));
+void Model::Undo(size_t trailSize) {
+	while (trail.size() > trailSize) {
+		int i = trail.back().first, t = trail.back().second;
+		trail.pop_back();
+		Restore(i, t);
+	}
 }
 
-std::cout << "Model created" << std::endl;
+bool Model::Regenerate(const Region &region, int seed, Delta &delta) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!complete) Error("Cannot regenerate a region of a model which holds no generated world");
+	if (region.x0 < 0 || region.y0 < 0 || region.z0 < 0 || region.x1 > FMX || region.y1 > FMY || region.z1 > FMZ ||
+		region.x0 >= region.x1 || region.y0 >= region.y1 || region.z0 >= region.z1)
+		Error("Region outside of the grid");
+	delta.blocks.clear();
+	delta.removed.clear();
+	delta.added.clear();
+
+	random = Philox(seed);
+	Statistics none = {Running, 0, 0, 0, 0, 0, 0, 0, 0};
+	statistics = none;
+	refutedInRow = 0;
+	forkSource.reset();
+	decisions.clear();
+	conflict.clear();
+	backtracks = 0;
+	stack.clear();
+	decidedCells.clear();
+	trail.clear();
+	solving = region;
+	complete = false;
+
+	// observed keeps the previous blocks of the region until it is generated
+	std::vector<int> previous;
+	for (int x = region.x0; x < region.x1; x++)
+		for (int y = region.y0; y < region.y1; y++)
+			for (int z = region.z0; z < region.z1; z++) previous.push_back(observed.get(x, y, z));
+
+	// the cells of the region get back the tiles of the start of a run, and the noise and draws of the seed,
+	// so that the result only depends on the seed and the blocks around
+	const InitialState &state = pinned ? *pinned : *initial;
+	for (int x = region.x0; x < region.x1; x++)
+		for (int y = region.y0; y < region.y1; y++)
+			for (int z = region.z0; z < region.z1; z++) {
+				int i = grid->index(x, y, z);
+				random.fill(&noise[i], grid->position(i), 1, 0, 1E-6);
+				observations[i] = 0;
+				for (int t = 0; t < T; t++)
+					if (state.wave.get(i, t) && !wave.get(i, t)) Restore(i, t);
+			}
 
-}
+	// the pins over the region: the restored state lacks those added or changed since the last run
+	std::vector<char> allowed(T);
+	for (size_t k = 0; k < pins.size(); k++) {
+		Pin pin = pins[k];
+		pin.x0 = std::max(pin.x0, region.x0);
+		pin.y0 = std::max(pin.y0, region.y0);
+		pin.z0 = std::max(pin.z0, region.z0);
+		pin.x1 = std::min(pin.x1, region.x1);
+		pin.y1 = std::min(pin.y1, region.y1);
+		pin.z1 = std::min(pin.z1, region.z1);
+		if (pin.x0 < pin.x1 && pin.y0 < pin.y1 && pin.z0 < pin.z1) BanOutside(pin, allowed);
+	}
 
+	// then lose the tiles incompatible with the block of a neighbor outside of it, which stays
+	for (int x = region.x0; x < region.x1; x++)
+		for (int y = region.y0; y < region.y1; y++)
+			for (int z = region.z0; z < region.z1; z++) {
+				int i = grid->index(x, y, z);
+				for (int d = 0; d < 6; d++) {
+					int i2 = grid->neighbor(i, d);
+					if (i2 < 0) continue;
+					const int *position = grid->position(i2);
+					if (position[0] >= region.x0 && position[0] < region.x1 && position[1] >= region.y0 &&
+						position[1] < region.y1 && position[2] >= region.z0 && position[2] < region.z1)
+						continue;
+
+					const std::vector<int> &tiles = tileset->supported[d * T + wave.first(i2)];
+					std::fill(allowed.begin(), allowed.end(), false);
+					for (size_t k = 0; k < tiles.size(); k++) allowed[tiles[k]] = true;
+					for (int t = 0; t < T; t++)
+						if (!allowed[t] && wave.get(i, t)) Ban(i, t);
+				}
+			}
 
-std::vector<Voxel> Model::rotateVoxels(std::vector<Voxel> array, size_t size) {
-	std::vector<Voxel> result;
-	for (Voxel voxel : array) {
-		result.push_back(Voxel(size - 1 - voxel.y, voxel.x, voxel.z, voxel.color));
+	statistics.status = PropagateNogoods() ? Search(std::function<bool()>()) : Contradiction;
+
+	bool generated = statistics.status == Success;
+	// otherwise the previous blocks, which agree with the ones around the region, are put back
+	if (!generated) Undo(0);
+	std::vector<int>::const_iterator before = previous.begin();
+	for (int x = region.x0; x < region.x1; x++)
+		for (int y = region.y0; y < region.y1; y++)
+			for (int z = region.z0; z < region.z1; z++, ++before) {
+				if (!generated) {
+					int i = grid->index(x, y, z);
+					for (int t = 0; t < T; t++)
+						if (t != *before && wave.get(i, t)) Ban(i, t);
+					continue;
+				}
+				int after = observed.get(x, y, z);
+				if (after == *before) continue;
+				Delta::Block block = {x, y, z, *before, after};
+				delta.blocks.push_back(block);
+				AppendVoxels(x, y, z, *before, delta.removed);
+				AppendVoxels(x, y, z, after, delta.added);
+			}
+	if (!generated) {
+		PropagateNogoods();
+		trail.clear();
+		decisions.clear();
 	}
-	return result;
+	complete = true;
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return generated;
 }
 
-Model::ObserveStates Model::Observe() {
-	double min = 1E+3, sum, mainSum, logSum, noise, entropy;
-	int argminx = -1, argminy = -1, argminz = -1, amount;
-	std::vector<bool> w;
-
-	for (int x = 0; x < FMX; x++)
-		for (int y = 0; y < FMY; y++)
-			for (int z = 0; z < FMZ; z++) {
-				amount = 0;
-				sum = 0;
+void Model::setPropagation(Propagation propagation) {
+	// the other propagations leave the counters as they were: those of a world still used by Regenerate must be recounted
+	bool recount = propagation == SupportCounters && this->propagation != SupportCounters && complete;
+	this->propagation = propagation;
+	pinned.reset();
+	if (recount) CountSupports();
+}
 
-				for (int t = 0; t < T; t++)
-					if (wave.get(x, y, z, t)) {
+void Model::CountSupports() {
+	// cells without a neighbor in a direction keep the counters of the initial state there
+	for (size_t i = 0; i < wave.cells(); i++) {
+		const int *neighbors = grid->neighbors(i);
+		for (int t = 0; t < T; t++)
+			for (int d = 0; d < 6; d++)
+				compatible[(i * T + t) * 6 + d] = neighbors[d] < 0 ? tileset->initialCompatible[t * 6 + d] : 0;
+	}
+	for (size_t i1 = 0; i1 < wave.cells(); i1++) {
+		const int *neighbors = grid->neighbors(i1);
+		for (int t1 = 0; t1 < T; t1++) {
+			if (!wave.get(i1, t1)) continue;
+			for (int d = 0; d < 6; d++) {
+				int i2 = neighbors[Grid::opposite[d]];
+				if (i2 < 0) continue;
+
+				const std::vector<int> &tiles = tileset->supported[d * T + t1];
+				for (size_t k = 0; k < tiles.size(); k++)
+					compatible[(i2 * T + tiles[k]) * 6 + d]++;
+			}
+		}
+	}
+}
 
-						amount += 1;
-						sum += stationary[t];
+Model::Model(std::string name, int FMX, int FMY, int FMZ, bool periodic, std::string groundName,
+			 Wave::Layout layout, Grid::Order order) :
+		Model(Tileset::Load(name, groundName), FMX, FMY, FMZ, periodic, layout, order) {}
+
+Model::Model(std::shared_ptr<const Tileset> tileset, int FMX, int FMY, int FMZ, bool periodic,
+			 Wave::Layout layout, Grid::Order order) : tileset(tileset) {
+	this->FMX = FMX;
+	this->FMY = FMY;
+	this->FMZ = FMZ;
+	this->periodic = periodic;
+	this->T = tileset->T;
+	this->backtrackBudget = 0;
+	this->stepBudget = 0;
+	this->timeBudget = 0;
+	Statistics none = {Contradiction, 0, 0, 0, 0, 0, 0, 0, 0};
+	this->statistics = none;
+	this->learning = false;
+	this->maxNogoodLength = 12;
+	this->lookaheadRadius = 0;
+	this->lookaheadCandidates = 4;
+	this->refutedInRow = 0;
+	this->lookaheadCentre = -1;
+	this->propagation = Bitsets;
+	this->pinsContradict = false;
+	this->heuristic = MinEntropy;
+	this->scanCursor = 0;
+	Region whole = {0, 0, 0, FMX, FMY, FMZ};
+	this->solving = whole;
+	this->complete = false;
+
+	// the planes are shifted by the offset of the neighbors, which only the x-major order keeps constant
+	if (layout == Wave::TileMajor && order != Grid::XMajor)
+		Error("The TileMajor layout of the wave needs the XMajor order of the cells");
+	grid = Grid::Get(FMX, FMY, FMZ, periodic, order);
+	observed = Array3D<int>(FMX, FMY, FMZ, -1);
+	wave = Wave(FMX, FMY, FMZ, T, layout);
+	compatible = AlignedVector<int>(wave.cells() * T * 6, 0);
+	sumsOfOnes = std::vector<int>(wave.cells(), 0);
+	sumsOfWeights = std::vector<double>(wave.cells(), 0);
+	sumsOfWeightLogWeights = std::vector<double>(wave.cells(), 0);
+	noise = std::vector<double>(wave.cells(), 0);
+	observations = std::vector<uint32_t>(wave.cells(), 0);
+	distribution = std::vector<double>(T, 0);
+	changedCells.reserve(wave.cells());
+	cellChanged = std::vector<char>(wave.cells(), false);
+	support = std::vector<uint64_t>(wave.words(), 0);
+	watches = std::vector<std::vector<int>>(wave.cells());
+
+	// smallest specialization whose fixed domain width holds the tileset
+	switch (wave.words()) {
+		case 1: propagateBitsets = &Model::PropagateBitsets<1>; break;
+		case 2: propagateBitsets = &Model::PropagateBitsets<2>; break;
+		case 4: propagateBitsets = &Model::PropagateBitsets<4>; break;
+		case 8: propagateBitsets = &Model::PropagateBitsets<8>; break;
+		default: propagateBitsets = &Model::PropagateBitsets<0>; break;
+	}
+	if (layout == Wave::TileMajor) {
+		const int *dx = Grid::dx, *dy = Grid::dy, *dz = Grid::dz;
+		size_t P = wave.planeWords();
+		propagateBitsets = &Model::PropagatePlanes;
+		tileChanged = std::vector<char>(T, false);
+		tileStamp = std::vector<unsigned>(T, 0);
+		stamp = 0;
+		changedFrom = wave.cells();
+		changedTo = 0;
+		planeUnion = AlignedVector<uint64_t>(P, 0);
+		planeAllowed = AlignedVector<uint64_t>(P, 0);
+		planeWrapped = AlignedVector<uint64_t>(P, 0);
+		planeInterior = AlignedVector<uint64_t>(6 * P, 0);
+		for (int d = 0; d < 6; d++) {
+			planeOffset[d] = (dx[d] * FMY + dy[d]) * FMZ + dz[d];
+			wrapOffset[d] = planeOffset[d] - (dx[d] * FMX * FMY + dy[d] * FMY) * FMZ - dz[d] * FMZ;
+			for (int x = 0; x < FMX; x++)
+				for (int y = 0; y < FMY; y++)
+					for (int z = 0; z < FMZ; z++) {
+						int nx = x + dx[d], ny = y + dy[d], nz = z + dz[d];
+						if (nx < 0 || nx >= FMX || ny < 0 || ny >= FMY || nz < 0 || nz >= FMZ) continue;
+						size_t i = grid->index(x, y, z);
+						planeInterior[d * P + i / 64] |= uint64_t(1) << (i % 64);
 					}
-				if (sum == 0)
-					return False;
+		}
+	}
+	initial = GetInitialState();
 
-				noise = 1E-6 * random();
+	std::cout << "Model created" << std::endl;
+}
 
-				if (amount == 1)
-					entropy = 0;
-				else if (amount == T)
-					entropy = logT;
-				else {
-					mainSum = 0;
-					logSum = std::log(sum);
-					for (int t = 0; t < T; t++)
-						if (wave.get(x, y, z, t))
-							mainSum += stationary[t] * logProb[t];
-					entropy = logSum - mainSum / sum;
-				}
-				if (entropy > 0 && entropy + noise < min) {
-					min = entropy + noise;
-					argminx = x;
-					argminy = y;
-					argminz = z;
-				}
-			}
 
-	if (argminx == -1 && argminy == -1 && argminz == -1) {
-		for (int x = 0; x < FMX; x++)
-			for (int y = 0; y < FMY; y++)
-				for (int z = 0; z < FMZ; z++)
-					for (int t = 0; t < T; t++)
-						if (wave.get(x, y, z, t)) {
-							observed.set(x, y, z, t);
-							break;
-						}
+Model::ObserveStates Model::Observe() {
+	int argmin = SelectCell();
+	if (argmin < 0) {
+		for (int x = solving.x0; x < solving.x1; x++)
+			for (int y = solving.y0; y < solving.y1; y++) {
+				ArrayView<int> column = observed.get(x, y);
+				for (int z = solving.z0; z < solving.z1; z++)
+					column[z] = wave.first(grid->index(x, y, z));
+			}
 
+		complete = true;
 		return True;
 	}
 
-	std::vector<double> distribution(T, 0);
+	if (sumsOfOnes[argmin] == 0)
+		return False;
+
 	for (int t = 0; t < T; t++)
-		distribution[t] = wave.get(argminx, argminy, argminz, t) ? stationary[t] : 0;
-	size_t r = rotateVector(std::move(distribution), random());
+		distribution[t] = wave.get(argmin, t) ? tileset->stationary[t] : 0;
+	const int *position = grid->position(argmin);
+	int r = rotateVector(distribution, random.uniform(position[0], position[1], position[2], ++observations[argmin]));
+
+	// a tile whose propagation empties a cell cannot be part of a world extending the current decisions:
+	// remove it, and let Search propagate the removal and choose the cell to observe again
+	if (lookaheadRadius > 0 && refutedInRow < lookaheadCandidates && !Lookahead(argmin, r)) {
+		refutedInRow++;
+		Ban(argmin, r);
+		return Unfinished;
+	}
+	refutedInRow = 0;
+	statistics.steps++;
+
+	if (backtrackBudget > 0 || learning) {
+		Decision decision = {trail.size(), argmin, r};
+		decisions.push_back(decision);
+	}
 	for (int t = 0; t < T; t++)
-		wave.set(argminx, argminy, argminz, t, t == r);
-	changes.set(argminx, argminy, argminz, true);
+		if (t != r && wave.get(argmin, t))
+			Ban(argmin, t);
 
 	return Unfinished;
 }
 
-bool Model::Propagate() {
-	bool change = false, b;
-	for (int x2 = 0; x2 < FMX; x2++)
-		for (int y2 = 0; y2 < FMY; y2++)
-			for (int z2 = 0; z2 < FMZ; z2++)
-				for (int d = 0; d < 6; d++) {
-					int x1 = x2, y1 = y2, z1 = z2;
-					if (d == 0) {
-						if (x2 == 0) {
-							if (!periodic) continue;
-							else x1 = FMX - 1;
-						} else x1 = x2 - 1;
-					} else if (d == 1) {
-						if (y2 == FMY - 1) {
-							if (!periodic) continue;
-							else y1 = 0;
-						} else y1 = y2 + 1;
-					} else if (d == 2) {
-						if (x2 == FMX - 1) {
-							if (!periodic) continue;
-							else x1 = 0;
-						} else x1 = x2 + 1;
-					} else if (d == 3) {
-						if (y2 == 0) {
-							if (!periodic) continue;
-							else y1 = FMY - 1;
-						} else y1 = y2 - 1;
-					} else if (d == 4) {
-						if (z2 == FMZ - 1) {
-							if (!periodic) continue;
-							else z1 = 0;
-						} else z1 = z2 + 1;
-					} else {
-						if (z2 == 0) {
-							if (!periodic) continue;
-							else z1 = FMZ - 1;
-						} else z1 = z2 - 1;
-					}
+void Model::Ban(int i, int t) {
+	wave.ban(i, t);
+	if (propagation == SupportCounters) stack.push_back(std::make_pair(i, t));
+	else if (wave.getLayout() == Wave::TileMajor) {
+		if (!tileChanged[t]) {
+			tileChanged[t] = true;
+			changedTiles.push_back(t);
+		}
+		changedFrom = std::min(changedFrom, i);
+		changedTo = std::max(changedTo, i + 1);
+	} else if (!cellChanged[i]) {
+		cellChanged[i] = true;
+		changedCells.push_back(i);
+	}
+	trail.push_back(std::make_pair(i, t));
 
-					if (!changes.get(x1, y1, z1)) continue;
+	sumsOfOnes[i] -= 1;
+	sumsOfWeights[i] -= tileset->stationary[t];
+	sumsOfWeightLogWeights[i] -= tileset->weightLogWeights[t];
+	UpdateEntropy(i);
+	if (learning && sumsOfOnes[i] == 1) decidedCells.push_back(i);
+}
 
-					for (int t2 = 0; t2 < T; t2++)
-						if (wave.get(x2, y2, z2, t2)) {
-							b = false;
+void Model::UpdateEntropy(int i) {
+	if (heuristic == Scanline) {
+		// removals never make a cell undecided, only undoing them can, which may move the cursor back
+		if (sumsOfOnes[i] > 1) {
+			const int *position = grid->position(i);
+			scanCursor = std::min(scanCursor, (position[0] * FMY + position[1]) * FMZ + position[2]);
+		}
+		return;
+	}
+	// cells with a single tile left are decided and cells with none are contradictions: neither is observable
+	if (sumsOfOnes[i] > 1) queue.update(i, Priority(i));
+	else queue.remove(i);
+}
 
-							for (int t1 = 0; t1 < T && !b; t1++)
-								if (wave.get(x1, y1, z1, t1))
-									b = propagator.get(d, t2, t1);
+double Model::Priority(int i) const {
+	if (heuristic == MinRemainingValues) return sumsOfOnes[i] + noise[i];
+	double sum = sumsOfWeights[i];
+	return std::log(sum) - sumsOfWeightLogWeights[i] / sum + noise[i];
+}
 
-							if (!b) {
-								wave.set(x2, y2, z2, t2, false);
-								changes.set(x2, y2, z2, true);
-								change = true;
-							}
-						}
-				}
+int Model::SelectCell() {
+	if (heuristic != Scanline) return queue.empty() ? -1 : queue.top();
+	// the cells after the last one of the box are decided
+	int end = ((solving.x1 - 1) * FMY + solving.y1 - 1) * FMZ + solving.z1;
+	while (scanCursor < end && sumsOfOnes[grid->indexAt(scanCursor)] <= 1) scanCursor++;
+	return scanCursor < end ? grid->indexAt(scanCursor) : -1;
+}
 
-	return change;
+void Model::setHeuristic(Heuristic heuristic) {
+	this->heuristic = heuristic;
 }
 
-void Model::Clear() {
-	for (int x = 0; x < FMX; x++)
-		for (int y = 0; y < FMY; y++)
-			for (int z = 0; z < FMZ; z++) {
-				for (int t = 0; t < T; t++)
-					wave.set(x, y, z, t, true);
-				changes.set(x, y, z, false);
+bool Model::Propagate() {
+	bool contradiction = false;
+
+	if (propagation == Bitsets) return (this->*propagateBitsets)();
+
+	// on contradiction the stack is still drained, without new bans, so that every removal
+	// on the trail has been applied to the support counters and can be undone symmetrically
+	while (!stack.empty()) {
+		int i1 = stack.back().first, t1 = stack.back().second;
+		stack.pop_back();
+
+		if (sumsOfOnes[i1] == 0) contradiction = true;
+
+		const int *neighbors = grid->neighbors(i1);
+		for (int d = 0; d < 6; d++) {
+			// cells i2 whose neighbor in direction d is i1 lose t1 as a support
+			int i2 = neighbors[Grid::opposite[d]];
+			if (i2 < 0) continue;
+
+			const std::vector<int> &tiles = tileset->supported[d * T + t1];
+			for (size_t k = 0; k < tiles.size(); k++) {
+				int t2 = tiles[k];
+				if (--compatible[(i2 * T + t2) * 6 + d] == 0 && !contradiction && wave.get(i2, t2) && InLookahead(i2))
+					Ban(i2, t2);
 			}
+		}
+	}
 
-	if (bounds >= 0) {
-		for (int y = 0; y < FMY; y++)
-			for (int z = 0; z < FMZ - 2; z++) {
-				for (int t = 0; t < T; t++)
-					if (t != bounds) {
-						wave.set(FMX - 1, y, z, t, false);
-						wave.set(0, y, z, t, false);
-					}
+	return !contradiction;
+}
 
+template<size_t FixedW>
+bool Model::PropagateBitsets() {
+	const size_t W = FixedW ? FixedW : wave.words();
+	uint64_t fixedSupport[FixedW ? FixedW : 1];
+	uint64_t *support = FixedW ? fixedSupport : &this->support[0];
+
+	while (!changedCells.empty()) {
+		int i1 = changedCells.back();
+		changedCells.pop_back();
+		cellChanged[i1] = false;
+
+		if (sumsOfOnes[i1] == 0) {
+			for (size_t k = 0; k < changedCells.size(); k++) cellChanged[changedCells[k]] = false;
+			changedCells.clear();
+			return false;
+		}
+
+		const int *neighbors = grid->neighbors(i1);
+		for (int d = 0; d < 6; d++) {
+			// tiles of the cells i2 whose neighbor in direction d is i1 must be allowed by a tile left in i1
+			int i2 = neighbors[Grid::opposite[d]];
+			if (i2 < 0 || !InLookahead(i2)) continue;
+
+			UnionOfMasks<FixedW>(support, tileset->mask(d), wave.cell(i1), T, W);
+			const uint64_t *cell2 = wave.cell(i2);
+			for (size_t w = 0; w < W; w++)
+				for (uint64_t removed = cell2[w] & ~support[w]; removed; removed &= removed - 1)
+					Ban(i2, w * 64 + Wave::lowestBit(removed));
+		}
+	}
 
-				changes.set(FMX - 1, y, z, true);
-				changes.set(0, y, z, true);
+	return true;
+}
 
-				for (int x = 1; x < FMX - 1; x++) {
-					if (y > 0 && y < FMY - 1) {
-						wave.set(x, y, z, bounds, false);
-						changes.set(x, y, z, true);
-					}
-				}
+bool Model::PropagatePlanes() {
+	const int P = wave.planeWords(), cells = wave.cells();
+
+	while (!changedTiles.empty()) {
+		sweptTiles.swap(changedTiles);
+		changedTiles.clear();
+		for (size_t k = 0; k < sweptTiles.size(); k++) tileChanged[sweptTiles[k]] = false;
+		int swept[2] = {changedFrom, changedTo};
+		changedFrom = cells;
+		changedTo = 0;
+
+		for (int d = 0; d < 6; d++) {
+			const uint64_t *interior = &planeInterior[d * P];
+
+			// words of the cells whose neighbor in direction d changed, and of these neighbors;
+			// every word when the grid wraps
+			int from = 0, to = P, unionFrom = 0, unionTo = P;
+			if (!periodic) {
+				int q = planeOffset[d] >= 0 ? planeOffset[d] / 64 : -((63 - planeOffset[d]) / 64);
+				from = std::max(swept[0] - planeOffset[d], 0) / 64;
+				to = (std::min(swept[1] - planeOffset[d], cells) + 63) / 64;
+				if (from >= to) continue;
+				unionFrom = std::max(from + q, 0);
+				unionTo = std::min(to + q + 2, P);
 			}
-		for (int x = 0; x < FMX; x++)
-			for (int z = 0; z < FMZ - 2; z++) {
-				for (int t = 0; t < T; t++)
-					if (t != bounds) {
-						wave.set(x, FMY - 1, z, t, false);
-						wave.set(x, 0, z, t, false);
-					}
 
-				changes.set(x, FMY - 1, z, true);
-				changes.set(x, 0, z, true);
+			// tiles which may lose a support in direction d: those supported by a changed tile
+			candidateTiles.clear();
+			stamp++;
+			for (size_t k = 0; k < sweptTiles.size(); k++) {
+				const std::vector<int> &tiles = tileset->supported[d * T + sweptTiles[k]];
+				for (size_t j = 0; j < tiles.size(); j++)
+					if (tileStamp[tiles[j]] != stamp) {
+						tileStamp[tiles[j]] = stamp;
+						candidateTiles.push_back(tiles[j]);
+					}
+			}
 
-				for (int y = 1; y < FMY - 1; y++) {
-					if (x > 0 && x < FMX - 1) {
-						wave.set(x, y, z, bounds, false);
-						changes.set(x, y, z, true);
+			for (size_t k = 0; k < candidateTiles.size(); k++) {
+				int t2 = candidateTiles[k];
+				uint64_t *plane2 = wave.plane(t2), any = 0;
+				for (int w = from; w < to; w++) any |= plane2[w];
+				if (!any) continue;
+
+				// cells whose neighbor in direction d allows a tile supporting t2
+				const std::vector<int> &tiles = tileset->supporters[d * T + t2];
+				std::fill(planeUnion.begin() + unionFrom, planeUnion.begin() + unionTo, 0);
+				for (size_t j = 0; j < tiles.size(); j++)
+					OrInto(&planeUnion[unionFrom], wave.plane(tiles[j]) + unionFrom, unionTo - unionFrom);
+				ShiftInto(&planeAllowed[0], &planeUnion[0], P, from, to, planeOffset[d]);
+				if (periodic) ShiftInto(&planeWrapped[0], &planeUnion[0], P, from, to, wrapOffset[d]);
+
+				for (int w = from; w < to; w++) {
+					// without periodicity, cells with no neighbor in direction d keep every tile
+					uint64_t allowed = (planeAllowed[w] & interior[w]) | (periodic ? planeWrapped[w] & ~interior[w] : ~interior[w]);
+					for (uint64_t removed = plane2[w] & ~allowed; removed; removed &= removed - 1) {
+						int i2 = w * 64 + Wave::lowestBit(removed);
+						if (!InLookahead(i2)) continue;
+						Ban(i2, t2);
+						if (sumsOfOnes[i2] == 0) {
+							for (size_t j = 0; j < changedTiles.size(); j++) tileChanged[changedTiles[j]] = false;
+							changedTiles.clear();
+							changedFrom = cells;
+							changedTo = 0;
+							return false;
+						}
 					}
 				}
 			}
+		}
 	}
-	if (ground >= 0) {
-		for (int x = 0; x < FMX; x++)
-			for (int y = 0; y < FMY; y++) {
+
+	return true;
+}
+
+void Model::Clear() {
+	const InitialState &state = pinned ? *pinned : *initial;
+	wave = state.wave;
+	if (propagation == SupportCounters) compatible = state.compatible;
+	sumsOfOnes = state.sumsOfOnes;
+	sumsOfWeights = state.sumsOfWeights;
+	sumsOfWeightLogWeights = state.sumsOfWeightLogWeights;
+	pinsContradict = pinned && pinned->contradiction;
+	stack.clear();
+	// the trail no longer leads back to a snapshot
+	trail.clear();
+	forkSource.reset();
+	decidedCells.clear();
+
+	std::fill(observations.begin(), observations.end(), 0);
+	queue.reset(wave.cells());
+	scanCursor = 0;
+	if (heuristic == Scanline) return;
+
+	random.fill(&noise[0], grid->position(0), noise.size(), 0, 1E-6);
+	for (size_t i = 0; i < wave.cells(); i++)
+		if (sumsOfOnes[i] > 1) queue.append(i, Priority(i));
+	queue.heapify();
+}
+
+std::shared_ptr<const Model::InitialState> Model::GetInitialState() {
+	typedef std::tuple<const Tileset *, const Grid *, Wave::Layout> Key;
+	static std::mutex mutex;
+	static std::map<Key, std::weak_ptr<const InitialState>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Key key(tileset.get(), grid.get(), wave.getLayout());
+	std::shared_ptr<const InitialState> state = cache[key].lock();
+	if (state) return state;
+	// forget the states no model uses any more, such as those of the grid sizes a viewer went through
+	for (std::map<Key, std::weak_ptr<const InitialState>>::iterator entry = cache.begin(); entry != cache.end();)
+		if (entry->second.expired()) entry = cache.erase(entry);
+		else ++entry;
+
+	wave.fill(true);
+	stack.clear();
+	queue.reset(wave.cells());
+	for (size_t i = 0; i < wave.cells(); i++) {
+		std::copy(tileset->initialCompatible.begin(), tileset->initialCompatible.end(), compatible.begin() + i * T * 6);
+		sumsOfOnes[i] = T;
+		sumsOfWeights[i] = tileset->startingSumOfWeights;
+		sumsOfWeightLogWeights[i] = tileset->startingSumOfWeightLogWeights;
+	}
+	// the counters of the initial state must be valid whichever propagation the runs use
+	Propagation mode = propagation;
+	propagation = SupportCounters;
+	// a tile compatible with no tile in direction d is not allowed where the cell has a neighbor in direction d,
+	// which the counters never detect since they start at 0
+	for (size_t i = 0; i < wave.cells(); i++)
+		for (int d = 0; d < 6; d++)
+			if (grid->neighbor(i, d) >= 0)
 				for (int t = 0; t < T; t++)
-					if (t != ground)
-						wave.set(x, y, FMZ - 1, t, false);
-				changes.set(x, y, FMZ - 1, true);
+					if (tileset->initialCompatible[t * 6 + d] == 0 && wave.get(i, t)) Ban(i, t);
+	std::vector<Pin> constraints = ConstraintPins();
+	std::vector<char> allowed(T);
+	for (size_t k = 0; k < constraints.size(); k++) BanOutside(constraints[k], allowed);
+
+	std::shared_ptr<InitialState> computed = std::make_shared<InitialState>();
+	computed->contradiction = !Propagate();
+	propagation = mode;
+	computed->tileset = tileset;
+	computed->grid = grid;
+	computed->wave = wave;
+	computed->compatible = compatible;
+	computed->sumsOfOnes = sumsOfOnes;
+	computed->sumsOfWeights = sumsOfWeights;
+	computed->sumsOfWeightLogWeights = sumsOfWeightLogWeights;
+	computed->nogoods = std::make_shared<NogoodStore>(*tileset, *grid);
+	cache[key] = computed;
+	return computed;
+}
 
-				for (int z = 0; z < FMZ - 1; z++) {
-					wave.set(x, y, z, ground, false);
-					changes.set(x, y, z, true);
-				}
-			}
+std::vector<Model::Pin> Model::ConstraintPins() const {
+	std::vector<Pin> constraints;
+	if (tileset->bounds >= 0) {
+		// walls of bounds around the grid, below its two upper layers, and no bounds inside
+		std::vector<int> bounds(1, tileset->bounds), inside;
+		for (int t = 0; t < T; t++)
+			if (t != tileset->bounds) inside.push_back(t);
+		Pin walls[4] = {{0, 0, 0, 1, FMY, FMZ - 2, bounds}, {FMX - 1, 0, 0, FMX, FMY, FMZ - 2, bounds},
+						{0, 0, 0, FMX, 1, FMZ - 2, bounds}, {0, FMY - 1, 0, FMX, FMY, FMZ - 2, bounds}};
+		Pin interior = {1, 1, 0, FMX - 1, FMY - 1, FMZ - 2, inside};
+		constraints.insert(constraints.end(), walls, walls + 4);
+		constraints.push_back(interior);
+	}
+	if (tileset->ground >= 0) {
+		// ground on the lowest layer, and only there
+		std::vector<int> ground(1, tileset->ground), above;
+		for (int t = 0; t < T; t++)
+			if (t != tileset->ground) above.push_back(t);
+		Pin layer = {0, 0, FMZ - 1, FMX, FMY, FMZ, ground}, upper = {0, 0, 0, FMX, FMY, FMZ - 1, above};
+		constraints.push_back(layer);
+		constraints.push_back(upper);
 	}
+	return constraints;
+}
+
+void Model::BanOutside(const Pin &pin, std::vector<char> &allowed) {
+	if (pin.x0 < 0 || pin.y0 < 0 || pin.z0 < 0 || pin.x1 > FMX || pin.y1 > FMY || pin.z1 > FMZ)
+		Error("Pin outside of the grid");
+	std::fill(allowed.begin(), allowed.end(), false);
+	for (size_t k = 0; k < pin.tiles.size(); k++) {
+		if (pin.tiles[k] < 0 || pin.tiles[k] >= T) Error("Pin of an unknown tile");
+		allowed[pin.tiles[k]] = true;
+	}
+
+	for (int x = pin.x0; x < pin.x1; x++)
+		for (int y = pin.y0; y < pin.y1; y++)
+			for (int z = pin.z0; z < pin.z1; z++) {
+				int i = grid->index(x, y, z);
+				for (int t = 0; t < T; t++)
+					if (!allowed[t] && wave.get(i, t)) Ban(i, t);
+			}
+}
+
+void Model::addPin(const Pin &pin) {
+	pins.push_back(pin);
+	pinned.reset();
+}
+
+void Model::addPin(int x, int y, int z, std::string tile, int sizeX, int sizeY, int sizeZ) {
+	Pin pin = {x, y, z, x + sizeX, y + sizeY, z + sizeZ, tileset->find(tile)};
+	if (pin.tiles.empty()) Error(("Pin of an unknown tile: " + tile).c_str());
+	addPin(pin);
+}
+
+void Model::clearPins() {
+	pins.clear();
+	pinned.reset();
+}
+
+bool Model::ApplyPins(const std::vector<Pin> &pins) {
+	std::vector<char> allowed(T);
+	for (size_t k = 0; k < pins.size(); k++) BanOutside(pins[k], allowed);
+	pinsContradict = !PropagateNogoods();
+	decisions.clear();
+	return !pinsContradict;
+}
+
+const Array3D<int> &Model::getObserved() const {
+	return observed;
+}
+
+void Model::AppendVoxels(int x, int y, int z, int tile, std::vector<Voxel> &voxels) const {
+	// the .vox files have their y and z axes reversed
+	int size = tileset->voxelsize;
+	for (Voxel v : tileset->voxeltiles[tile])
+		voxels.push_back(Voxel(v.x + x * size, v.y + (FMY - y - 1) * size, v.z + (FMZ - z - 1) * size, v.color));
 }
 
 void Model::saveVoxelOutput(std::string filename)
+{
+	saveVoxelOutput(filename, observed);
+}
+
+void Model::saveVoxelOutput(std::string filename, const Array3D<int> &observed)
 {
 	std::vector<Voxel> result;
 	for (int8_t x = 0; x < FMX; x++)
-        for (int8_t y = 0; y < FMY; y++)
-            for (int8_t z = 0; z < FMZ; z++)
-			{
-				int index = observed.get(x, FMY - y - 1, FMZ - z - 1);
-
-				if(index >= 0) {
-					for (Voxel v : voxeltiles[index])
-						result.push_back(Voxel((v.x + x * voxelsize), (v.y + y * voxelsize), (v.z + z * voxelsize),
-											   v.color));
-				}
+		for (int8_t y = 0; y < FMY; y++) {
+			ArrayView<const int> column = observed.get(x, FMY - y - 1);
+			for (int8_t z = 0; z < FMZ; z++) {
+				int index = column[FMZ - z - 1];
+
+				if (index >= 0) AppendVoxels(x, FMY - y - 1, FMZ - z - 1, index, result);
 			}
+		}
 
-	WriteVox(filename, FMX * voxelsize, FMY * voxelsize, FMZ * voxelsize, result);
-}
\ No newline at end of file
+	WriteVox(filename, FMX * tileset->voxelsize, FMY * tileset->voxelsize, FMZ * tileset->voxelsize, result);
+}
@@ -8,14 +8,18 @@
 #ifndef WFCTILEMAPGENERATION_MODEL_H
 #define WFCTILEMAPGENERATION_MODEL_H
 
-#include <pugixml.hpp>
-#include <map>
 #include <iostream>
+#include <functional>
+#include <memory>
 #include "utils.h"
 #include "gl.h"
 #include "voxels.h"
-#include <array>
-#include <boost/algorithm/string.hpp>
+#include "tileset.h"
+#include "wave.h"
+#include "grid.h"
+#include "entropy_queue.h"
+#include "random.h"
+#include "nogoods.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #undef STB_IMAGE_IMPLEMENTATION
@@ -28,63 +32,431 @@
  *
  * Adapted from C# implementation: https://bitbucket.org/mxgmn/basic3dwfc/src/master/
  *
+ * A Model only holds the state of a run (wave, counters, observed blocks); the tiles and rules
+ * are borrowed from a read-only Tileset, so copies of a Model share the same tileset.
  */
 
 class Model {
+public:
+    /**
+     * How the removal of tiles is propagated to the neighbors
+     * SupportCounters: AC-4, each removal decrements counters of compatible tiles in the neighbors
+     * Bitsets: each changed cell intersects its neighbors with the union of the masks of its remaining tiles
+     */
+    enum Propagation {
+        SupportCounters, Bitsets
+    };
+
+    /**
+     * How Observe chooses the cell to decide
+     * MinEntropy: the undecided cell whose tile weights have the lowest entropy
+     * MinRemainingValues: the undecided cell with the fewest tiles left
+     * Scanline: the first undecided cell in x-major order, found by a cursor without maintaining a queue,
+     * which suits the tilesets whose rules seldom lead to contradictions
+     * Ties are broken by a small noise per cell, drawn at each run.
+     */
+    enum Heuristic {
+        MinEntropy, MinRemainingValues, Scanline
+    };
+
+    /**
+     * Constraint on a box of cells [x0, x1) x [y0, y1) x [z0, z1): only the listed tiles are allowed there,
+     * for example a road, a spawn point or a block edited by hand
+     */
+    struct Pin {
+        int x0, y0, z0, x1, y1, z1;
+        std::vector<int> tiles;
+    };
+
+    /**
+     * Box of cells [x0, x1) x [y0, y1) x [z0, z1), for example a region to regenerate
+     */
+    struct Region {
+        int x0, y0, z0, x1, y1, z1;
+    };
+
+    /**
+     * Changes made by Regenerate: the blocks whose tile changed, and the voxels of the .vox file
+     * (see saveVoxelOutput) of their previous tiles, to remove, and of their new tiles, to add
+     */
+    struct Delta {
+        struct Block {
+            int x, y, z, before, after;
+        };
+        std::vector<Block> blocks;
+        std::vector<Voxel> removed, added;
+    };
+
+    /**
+     * How a run ended
+     * Success: every block is assigned
+     * Contradiction: a block has no possible assignation left, and backtracking could not fix it
+     * Aborted: the run reached its step or time budget
+     * Cancelled: the cancellation callback returned true
+     * Running: the run has not ended yet (see Step)
+     */
+    enum Status {
+        Success, Contradiction, Aborted, Cancelled, Running
+    };
+
+    /**
+     * Statistics of a run: how it ended, number of steps (observations), contradictions met
+     * (including the ones backtracking recovered from), backtracks, duration, with nogood learning,
+     * the nogoods learned at its end and the tiles the known nogoods removed during it,
+     * and with the lookahead, the tiles it tried and those it found to lead to a contradiction
+     */
+    struct Statistics {
+        Status status;
+        long steps;
+        int contradictions, backtracks;
+        double seconds;
+        int learned, pruned;
+        int probes, refuted;
+    };
+
 private:
 
     enum ObserveStates {
         True, False, Unfinished
     };
 
-    Array4D<bool> wave;
-    Array3D<bool> changes;
+    /**
+     * A tile chosen by Observe, with the size of the trail before the choice
+     */
+    struct Decision {
+        size_t trailSize;
+        int cell, tile;
+    };
+
+    /**
+     * State of the wave once the constraints (bounds, ground) are applied and propagated,
+     * shared by every model of same tileset, grid and layout, with the nogoods they learned
+     */
+    struct InitialState {
+        std::shared_ptr<const Tileset> tileset;
+        std::shared_ptr<const Grid> grid;
+        Wave wave;
+        AlignedVector<int> compatible;
+        std::vector<int> sumsOfOnes;
+        std::vector<double> sumsOfWeights, sumsOfWeightLogWeights;
+        bool contradiction;
+        std::shared_ptr<NogoodStore> nogoods;
+    };
+
+    std::shared_ptr<const Tileset> tileset;
+    std::shared_ptr<const InitialState> initial;
+
+    /**
+     * Order and neighbors of the cells, shared by every model of same dimensions, periodicity and order.
+     * observed stays in x-major order whatever the order of the grid.
+     */
+    std::shared_ptr<const Grid> grid;
+
+    Wave wave;
     Array3D<int> observed;
-    std::vector<double> stationary;
 
-    int FMX, FMY, FMZ, T, ground, bounds;
+    int FMX, FMY, FMZ, T;
     bool periodic;
 
-    std::vector<double> logProb;
-    double logT;
-    std::function<double()> random;
+    /**
+     * Generator of the current run, seeded by Run. Draws are keyed by the coordinates of their cell and an index:
+     * 0 for the noise of the cell, 1 + k for the k-th observation of the cell in the run
+     */
+    Philox random;
+    std::vector<uint32_t> observations;
+
+    /**
+     * Running sums per cell, updated on each ban: number of tiles left,
+     * sum of their weights w and of their w * log(w), used to get the entropy of the cell
+     */
+    std::vector<int> sumsOfOnes;
+    std::vector<double> sumsOfWeights, sumsOfWeightLogWeights;
+
+    /**
+     * Small random value per cell, drawn at each Clear, to break ties between cells of same entropy
+     */
+    std::vector<double> noise;
+
+    /**
+     * Undecided cells (more than one tile left) ordered by the priority of the heuristic,
+     * and with Scanline, the x-major position before which every cell is decided
+     */
+    Heuristic heuristic;
+    EntropyQueue queue;
+    int scanCursor;
+
+    /**
+     * Box of the cells the run decides, the whole grid unless it regenerates a region,
+     * and whether the wave holds a complete world, the one of observed
+     */
+    Region solving;
+    bool complete;
+
+    /**
+     * Scratch buffer of Observe: weight of each tile allowed in the observed cell
+     */
+    std::vector<double> distribution;
+
+    /**
+     * compatible[(i * T + t) * 6 + d]: number of tiles still allowed in the neighbor of the cell i
+     * in direction d which are compatible with the tile t in i (AC-4 support counters)
+     */
+    AlignedVector<int> compatible;
+
+    Propagation propagation;
 
-    Array3D<bool> propagator;
+    /**
+     * Removals (cell, tile) not yet propagated to the neighbors, with SupportCounters
+     */
+    std::vector<std::pair<int, int>> stack;
+
+    /**
+     * Cells changed and not yet propagated to the neighbors, with Bitsets
+     */
+    std::vector<int> changedCells;
+    std::vector<char> cellChanged;
+    std::vector<uint64_t> support;
+
+    /**
+     * Tiles whose plane changed and not yet propagated, with Bitsets and the TileMajor layout,
+     * and the range [changedFrom, changedTo) of the cells where they were removed
+     */
+    std::vector<int> changedTiles, sweptTiles, candidateTiles;
+    std::vector<char> tileChanged;
+    std::vector<unsigned> tileStamp;
+    unsigned stamp;
+    int changedFrom, changedTo;
+
+    /**
+     * planeInterior[d * P + w]: word w of the plane of the cells which have a neighbor in direction d inside the grid,
+     * planeOffset[d] (wrapOffset[d]): index of the neighbor in direction d minus the index of the cell, inside (across) the grid border
+     */
+    AlignedVector<uint64_t> planeInterior;
+    int planeOffset[6], wrapOffset[6];
+
+    /**
+     * Scratch planes of PropagatePlanes
+     */
+    AlignedVector<uint64_t> planeUnion, planeAllowed, planeWrapped;
+
+    /**
+     * Every removal (cell, tile) since the end of the initial propagation, in order, to undo them when backtracking
+     */
+    std::vector<std::pair<int, int>> trail;
+    std::vector<Decision> decisions;
+    int backtrackBudget, backtracks;
+
+    /**
+     * Budget of a run, 0 for unlimited, and statistics of the last run
+     */
+    long stepBudget;
+    double timeBudget;
+    Statistics statistics;
+
+    /**
+     * Nogood learning: the nogoods of the store known by this model, watches[i]: the nogoods with a literal in
+     * the cell i, decidedCells: the cells left with a single tile and not yet checked against the nogoods,
+     * conflict: the decisions when the last contradiction was found
+     */
+    bool learning;
+    int maxNogoodLength;
+    std::vector<Nogood> nogoods;
+    std::vector<std::vector<int>> watches;
+    std::vector<int> decidedCells;
+    std::vector<Decision> conflict;
+
+    /**
+     * Pins applied at the start of every run, the initial state once they are applied and propagated,
+     * computed by the first run after they changed, and whether the pins of the current run contradict
+     */
+    std::vector<Pin> pins;
+    std::shared_ptr<const InitialState> pinned;
+    bool pinsContradict;
 
-    std::vector<std::string> tilenames;
-    std::vector<std::vector<Voxel>> voxeltiles;
+    /**
+     * The snapshot the state was last forked from, if the trail holds every change since (see Fork)
+     */
+    std::shared_ptr<const Model> forkSource;
 
-    int voxelsize;
+    /**
+     * Lookahead: radius of the tentative propagations, 0 when disabled, number of tiles tried per decision,
+     * tiles refuted since the last decision, and the cell of the running tentative propagation, -1 if none
+     */
+    int lookaheadRadius, lookaheadCandidates, refutedInRow;
+    int lookaheadCentre;
 
     /**
-     * Perform a 90deg Rotate of a block of voxels on the x-y coordinates
-     * @param array the vector containing all the voxels of the block
-     * @param size the width=height=depth of the block
-     * @return the rotated block of voxels
+     * Step until the run ends
      */
-    std::vector<Voxel> rotateVoxels(std::vector<Voxel> array, size_t size);
+    Status Search(std::function<bool()> cancelled);
 
     /**
-     * Look for a block to be randomly assigned among a set of "authorized" blocks
+     * Randomly assign the undecided block of lowest entropy among its set of "authorized" blocks
      * If all block have been assigned return true
      * If a block have 0 authorized assignation there is a contradiction, return false
      * If a block have been correctly assigned but there is still blocks to assign return Unfinished
+     * With the lookahead, the chosen tile may instead be removed from the block, also returning Unfinished
      */
     ObserveStates Observe();
 
     /**
-     * Update the list of possible assignation of each blocks depending on the newly assigned block and the rules.
+     * Update the list of possible assignation of each blocks depending on the removals on the stack and the rules.
+     * Each removal only visits the neighbors of its cell and the tiles it was supporting there.
+     * @return false if a contradiction occurs (a cell has no possible assignation left)
      */
     bool Propagate();
 
     /**
-     * Set the constraints of the model, before the launch of the algorithm
-     * For example, the bounds, the ground.
+     * Propagate with the Bitsets method
+     * @tparam FixedW the number of words of a cell (1, 2, 4 or 8, for up to 64, 128, 256 or 512 tiles),
+     * so domains are inline arrays and loops over words unroll, or 0 for larger tilesets
+     */
+    template<size_t FixedW>
+    bool PropagateBitsets();
+
+    /**
+     * Propagate, then remove the tiles forbidden by the nogoods whose other literals all hold, until nothing changes
+     * @return false if a contradiction occurs or a nogood has all its literals hold
+     */
+    bool PropagateNogoods();
+
+    /**
+     * Add to the nogoods of the model those the store learned since
+     */
+    void SyncNogoods();
+
+    /**
+     * Learn the nogoods of the conflict of a failed run: the smallest subset of its decisions, taken from the
+     * nearest to the last one, which still contradicts, made minimal by removing decisions one at a time,
+     * then its images by the symmetries which also contradict. Leaves the wave in its initial state.
+     */
+    void Learn();
+
+    /**
+     * Tentatively assign the tile t to the cell i and propagate, only to the cells within the lookahead radius,
+     * then undo it
+     * @return false if a cell was left without any tile
+     */
+    bool Lookahead(int i, int t);
+
+    /**
+     * @return true if the propagation may remove tiles from the cell i: no lookahead is running,
+     * or the cell is within its radius
+     */
+    bool InLookahead(int i) const;
+
+    /**
+     * Assign the tile t to the cell i and propagate
+     * @return false if t is not allowed in i or the propagation contradicts
+     */
+    bool Assume(int i, int t);
+
+    /**
+     * @return true if assigning every literal of the nogood from the initial state contradicts
+     */
+    bool Refutes(const Nogood &nogood);
+
+    /**
+     * Propagate with the Bitsets method on the TileMajor layout: for each direction, the plane of a tile
+     * is intersected with the union of the planes of its supporters, shifted by the offset of the neighbor.
+     * Only the tiles supported by a changed tile, around the cells which changed, are visited.
+     */
+    bool PropagatePlanes();
+
+    /**
+     * The PropagateBitsets specialization chosen for the tileset, or PropagatePlanes with the TileMajor layout
+     */
+    bool (Model::*propagateBitsets)();
+
+    /**
+     * Remove the tile t from the cell i and push the removal on the propagation stack
+     */
+    void Ban(int i, int t);
+
+    /**
+     * Ban every tile the pin does not allow in its box, without propagating
+     * @param allowed scratch buffer of T flags
+     */
+    void BanOutside(const Pin &pin, std::vector<char> &allowed);
+
+    /**
+     * Update the position of the cell i in the entropy queue after a change of its tiles
+     */
+    void UpdateEntropy(int i);
+
+    /**
+     * @return the key of the undecided cell i in the entropy queue, lowest first
+     */
+    double Priority(int i) const;
+
+    /**
+     * @return the next cell to observe according to the heuristic, -1 if every cell is decided
+     */
+    int SelectCell();
+
+    /**
+     * Allow again the tile t in the cell i, the reverse of Ban without the trail
+     */
+    void Restore(int i, int t);
+
+    /**
+     * Count the support counters of the current wave again, after propagations which did not maintain them
+     */
+    void CountSupports();
+
+    /**
+     * Restore every removal done after the trail had the given size
+     */
+    void Undo(size_t trailSize);
+
+    /**
+     * Roll back to the last decision and forbid the tile it chose, until the propagation succeeds
+     * @return false if there is no decision left or the backtrack budget is exhausted
+     */
+    bool Backtrack();
+
+    /**
+     * Reset the model to its initial state before the launch of the algorithm:
+     * restore the precomputed constrained wave and draw the noise of each cell.
+     * The next fork copies the state of its snapshot again.
      */
     void Clear();
 
+    /**
+     * @return the pins of the tiles which are only allowed at some positions, the bounds and the ground
+     */
+    std::vector<Pin> ConstraintPins() const;
+
+    /**
+     * Append the voxels of the tile at the block (x, y, z), in the coordinates of the .vox files
+     */
+    void AppendVoxels(int x, int y, int z, int tile, std::vector<Voxel> &voxels) const;
+
+    /**
+     * Find in the cache, or compute, the propagated initial state for this tileset, grid and layout
+     */
+    std::shared_ptr<const InitialState> GetInitialState();
+
 public:
-    Model(std::string name, int FMX, int FMY, int FMZ, bool periodic, std::string groundName);
+    /**
+     * State of a run after some decisions, from which runs with other seeds can continue (see Fork):
+     * a copy of the model, made once, shared by every fork
+     */
+    typedef std::shared_ptr<const Model> Snapshot;
+
+    /**
+     * Load the tileset ../name/data.xml and create a model of FMX x FMY x FMZ blocks using it
+     * @param layout how the wave is stored: CellMajor suits large tilesets, TileMajor large grids of few tiles
+     * @param order order of the cells in the wave, counters and entropy sums; TileMajor needs XMajor
+     */
+    Model(std::string name, int FMX, int FMY, int FMZ, bool periodic, std::string groundName,
+          Wave::Layout layout = Wave::CellMajor, Grid::Order order = Grid::XMajor);
+
+    /**
+     * Create a model of FMX x FMY x FMZ blocks on an already loaded tileset, which is shared and not copied
+     */
+    Model(std::shared_ptr<const Tileset> tileset, int FMX, int FMY, int FMZ, bool periodic,
+          Wave::Layout layout = Wave::CellMajor, Grid::Order order = Grid::XMajor);
 
     /**
      * Run an instance of the Simple Tile model with a specific seed for randomness
@@ -93,11 +465,151 @@ public:
      */
     bool Run(int seed);
 
+    /**
+     * Same as Run(seed), but give up (and return false) as soon as cancelled() returns true
+     */
+    bool Run(int seed, std::function<bool()> cancelled);
+
+    /**
+     * Fork the snapshot with the seed and run it to its end
+     * @return true if the model have been created, false if a contradiction occurs
+     */
+    bool Run(const Snapshot &snapshot, int seed);
+
+    /**
+     * Start a run with the seed, from the initial state; Run(seed) is Begin(seed) then Step() until the run ends
+     */
+    void Begin(int seed);
+
+    /**
+     * Observe one block and propagate, backtracking on a contradiction when enabled
+     * @return Running until the run ends, then Success or Contradiction
+     */
+    Status Step();
+
+    /**
+     * Pin a box of cells to a set of tiles at the start of every later run, until clearPins.
+     * The pins are applied together, as one batch of removals propagated once, by the next run;
+     * the runs after it start from the state it reached. No nogood is learned while pins are set.
+     */
+    void addPin(const Pin &pin);
+
+    /**
+     * Pin the cell (x, y, z), or the box of sizeX x sizeY x sizeZ cells from it, to the tiles of a name,
+     * see Tileset::find
+     */
+    void addPin(int x, int y, int z, std::string tile, int sizeX = 1, int sizeY = 1, int sizeZ = 1);
+
+    void clearPins();
+
+    /**
+     * Apply pins to the current run, between two steps: their removals are propagated once,
+     * and the decisions made so far are kept for good, so that backtracking never undoes the pins.
+     * @return false if the pins contradict the run, which then ends with a contradiction
+     */
+    bool ApplyPins(const std::vector<Pin> &pins);
+
+    /**
+     * @return a snapshot of the current run, to fork it later
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * Continue the run of the snapshot with another seed: the decisions of the snapshot are kept
+     * and the next ones are drawn from the seed (the ties between blocks stay those of the snapshot's seed).
+     * The model must have the tileset, grid, layout, propagation and heuristic of the snapshot.
+     * The first fork copies the state of the snapshot, which is cheaper than starting a run; the next forks
+     * of the same snapshot only undo, through the trail, what the previous one changed when it changed few cells.
+     * Nogoods are not learned in a fork, since its contradictions may depend on the decisions of the snapshot.
+     */
+    void Fork(const Snapshot &snapshot, int seed);
+
+    /**
+     * Generate the region again with another seed, keeping the blocks around it: the cells of the region get back
+     * the tiles they allow at the start of a run, with the current pins, lose those incompatible with the blocks
+     * around, and are decided like in a run, which only visits the region and its border.
+     * The model must hold a generated world.
+     * @param delta the blocks the regeneration changed and their voxels
+     * @return true if the region was generated; otherwise it keeps its previous blocks and delta is empty
+     */
+    bool Regenerate(const Region &region, int seed, Delta &delta);
+
+    /**
+     * Enable backtracking: on a contradiction, instead of failing, Run rolls back to the last decision
+     * and forbids the chosen tile there, at most budget times per run.
+     * @param budget maximum number of backtracks per run, 0 to disable backtracking
+     */
+    void setBacktrackBudget(int budget);
+
+    /**
+     * Give up a run (status Aborted) once it made steps observations, 0 for no limit.
+     * Unlike a time budget, a step budget keeps the runs reproducible.
+     */
+    void setStepBudget(long steps);
+
+    /**
+     * Give up a run (status Aborted) once it lasted seconds, 0 for no limit
+     */
+    void setTimeBudget(double seconds);
+
+    /**
+     * @return the statistics of the last run
+     */
+    const Statistics &getStatistics() const;
+
+    /**
+     * Enable nogood learning: at the end of a run which contradicts, record the decisions which caused it,
+     * and their symmetric images, in a store shared by every model of this tileset and grid, so that later runs
+     * remove a tile as soon as it would complete a known nogood.
+     * The worlds then depend on the nogoods learned before, so the same seeds only give the same worlds from the same store.
+     * @param maxLength longest nogood learned, in decisions: longer ones are expensive to find and seldom met again
+     */
+    void setNogoodLearning(bool enabled, int maxLength = 12);
+
+    /**
+     * Check the nogoods of the store against the state of the start of a run, without using them to propagate:
+     * each must contradict once all its tiles are assigned. Leaves the model in that state.
+     * @return the number of stored nogoods which do not, 0 if they are all sound
+     */
+    int CheckNogoods();
+
+    /**
+     * Enable the lookahead: before a decision, the chosen tile is tentatively propagated up to radius cells around,
+     * and if it leaves a cell without tiles it is removed and the cell to observe is chosen again.
+     * The removal follows from the decisions already made, so it is kept until they are backtracked.
+     * @param radius distance (in cells, along each axis) the tentative propagation reaches, 0 to disable the lookahead
+     * @param candidates maximum number of tiles tried per decision
+     */
+    void setLookahead(int radius, int candidates = 4);
+
+    /**
+     * Choose how the cell to decide is chosen (MinEntropy by default)
+     */
+    void setHeuristic(Heuristic heuristic);
+
+    /**
+     * Choose how removals are propagated (Bitsets by default). Both give the same worlds.
+     * Switching to SupportCounters with a generated world counts the supports of the world, for Regenerate.
+     */
+    void setPropagation(Propagation propagation);
+
     /**
      * Save the last generated model into a .vox file (MagicaVoxel extension)
      * @param filename name of the file we want to save the model
      */
     void saveVoxelOutput(std::string filename);
+
+    /**
+     * Save a grid of tiles generated by this model, for example by a copy of it, into a .vox file
+     * @param filename name of the file we want to save the model
+     * @param observed the tile of each block
+     */
+    void saveVoxelOutput(std::string filename, const Array3D<int> &observed);
+
+    /**
+     * @return the tile of each block of the last generated model
+     */
+    const Array3D<int> &getObserved() const;
 };
 
 #endif
\ No newline at end of file
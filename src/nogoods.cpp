@@ -0,0 +1,86 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "nogoods.h"
+
+#include <algorithm>
+
+NogoodStore::NogoodStore(const Tileset &tileset, const Grid &grid, size_t capacity) : capacity(capacity) {
+	const int T = tileset.T;
+
+	// symmetries of the grid about its centre: swap x and y (only for a square grid), then mirror x and/or y
+	for (int g = 0; g < 8; g++) {
+		bool swap = g & 4, flipX = g & 1, flipY = g & 2;
+		if (swap && grid.FMX != grid.FMY) continue;
+
+		// direction d of the grid is moved to the direction directions[d]
+		int directions[6];
+		for (int d = 0; d < 6; d++) {
+			int x = swap ? Grid::dy[d] : Grid::dx[d], y = swap ? Grid::dx[d] : Grid::dy[d];
+			if (flipX) x = -x;
+			if (flipY) y = -y;
+			for (int e = 0; e < 6; e++)
+				if (Grid::dx[e] == x && Grid::dy[e] == y && Grid::dz[e] == Grid::dz[d]) directions[d] = e;
+		}
+
+		std::vector<int> cells(grid.cells());
+		for (int i = 0; i < grid.cells(); i++) {
+			const int *position = grid.position(i);
+			int x = swap ? position[1] : position[0], y = swap ? position[0] : position[1];
+			if (flipX) x = grid.FMX - 1 - x;
+			if (flipY) y = grid.FMY - 1 - y;
+			cells[i] = grid.index(x, y, position[2]);
+		}
+
+		// the symmetries s of the tiles which, with this symmetry of the grid, map every rule on a rule
+		for (int s = 0; s < 8; s++) {
+			if (g == 0 && s == 0) continue;
+			bool rules = true;
+			for (int d = 0; d < 6 && rules; d++)
+				for (int t2 = 0; t2 < T && rules; t2++)
+					for (int t1 = 0; t1 < T && rules; t1++)
+						rules = tileset.propagator.get(d, t2, t1) ==
+								tileset.propagator.get(directions[d], tileset.action[t2][s], tileset.action[t1][s]);
+			if (!rules) continue;
+
+			std::vector<int> tiles(T);
+			for (int t = 0; t < T; t++) tiles[t] = tileset.action[t][s];
+			cellMaps.push_back(cells);
+			tileMaps.push_back(tiles);
+		}
+	}
+}
+
+bool NogoodStore::add(Nogood nogood) {
+	std::sort(nogood.begin(), nogood.end());
+	std::lock_guard<std::mutex> lock(mutex);
+	if (nogoods.size() >= capacity || !known.insert(nogood).second) return false;
+	nogoods.push_back(nogood);
+	return true;
+}
+
+size_t NogoodStore::size() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return nogoods.size();
+}
+
+void NogoodStore::copy(size_t from, std::vector<Nogood> &nogoods) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t k = from; k < this->nogoods.size(); k++) nogoods.push_back(this->nogoods[k]);
+}
+
+std::vector<Nogood> NogoodStore::images(const Nogood &nogood) const {
+	std::vector<Nogood> images;
+	for (size_t k = 0; k < cellMaps.size(); k++) {
+		Nogood image;
+		for (size_t j = 0; j < nogood.size(); j++)
+			image.push_back(std::make_pair(cellMaps[k][nogood[j].first], tileMaps[k][nogood[j].second]));
+		std::sort(image.begin(), image.end());
+		if (image != nogood && std::find(images.begin(), images.end(), image) == images.end()) images.push_back(image);
+	}
+	return images;
+}
@@ -0,0 +1,69 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_NOGOODS_H
+#define WFCTILEMAPGENERATION_NOGOODS_H
+
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+#include "grid.h"
+#include "tileset.h"
+
+/**
+ * A nogood: assignments (cell, tile) which the propagation from the initial state of a model turns
+ * into a contradiction, so that no world assigns all of them. Its literals are sorted.
+ */
+typedef std::vector<std::pair<int, int>> Nogood;
+
+/**
+ * Nogoods learned by the models of the same tileset and grid, shared between their runs and threads.
+ * Also holds the symmetries of the grid (about its centre, in x and y) which, combined with a symmetry
+ * of the tiles, keep the adjacency rules: the images of a nogood under them are candidate nogoods too.
+ */
+class NogoodStore {
+public:
+	/**
+	 * @param capacity number of nogoods kept, later ones are dropped
+	 */
+	NogoodStore(const Tileset &tileset, const Grid &grid, size_t capacity = 4096);
+
+	/**
+	 * Add a nogood, whose literals are sorted first
+	 * @return false if it was already known or the store is full
+	 */
+	bool add(Nogood nogood);
+
+	/**
+	 * @return the number of nogoods stored
+	 */
+	size_t size() const;
+
+	/**
+	 * Append the nogoods from the index from on to nogoods
+	 */
+	void copy(size_t from, std::vector<Nogood> &nogoods) const;
+
+	/**
+	 * @return the images of the nogood under the symmetries keeping the rules, other than the identity
+	 */
+	std::vector<Nogood> images(const Nogood &nogood) const;
+
+private:
+	mutable std::mutex mutex;
+	std::vector<Nogood> nogoods;
+	std::set<Nogood> known;
+	size_t capacity;
+
+	/**
+	 * cellMaps[k][i], tileMaps[k][t]: image of the cell i and of the tile t by the k-th symmetry
+	 */
+	std::vector<std::vector<int>> cellMaps, tileMaps;
+};
+
+#endif //WFCTILEMAPGENERATION_NOGOODS_H
@@ -0,0 +1,60 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+
+ParallelRunner::ParallelRunner(const Model &model, unsigned threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	models = std::vector<Model>(threads, model);
+}
+
+GenerationResult ParallelRunner::Run(const std::vector<int> &seeds) {
+	int count = seeds.size();
+	std::atomic<int> next(0), best(count);
+	std::vector<int> successes(models.size(), -1);
+	std::vector<RestartStatistics> statistics(models.size());
+	std::vector<std::thread> workers;
+
+	for (size_t w = 0; w < models.size(); w++)
+		workers.push_back(std::thread([&, w]() {
+			Model &model = models[w];
+			while (true) {
+				int index = next++;
+				if (index >= best) return;
+
+				policy.apply(model, index);
+				bool success = model.Run(seeds[index], [&]() { return best < index; });
+				statistics[w].add(model.getStatistics());
+				if (!success) continue;
+
+				// the next indices are all after this one: the thread stops here and its model keeps the grid
+				successes[w] = index;
+				int current = best;
+				while (index < current && !best.compare_exchange_weak(current, index));
+				return;
+			}
+		}));
+	for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+
+	GenerationResult result;
+	result.success = best < count;
+	result.index = best;
+	result.seed = result.success ? seeds[best] : 0;
+	for (size_t w = 0; w < models.size(); w++) {
+		if (result.success && successes[w] == result.index)
+			result.observed = models[w].getObserved();
+		result.statistics.add(statistics[w]);
+	}
+	return result;
+}
+
+void ParallelRunner::setRestartPolicy(const RestartPolicy &policy) {
+	this->policy = policy;
+}
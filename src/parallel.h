@@ -0,0 +1,60 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_PARALLEL_H
+#define WFCTILEMAPGENERATION_PARALLEL_H
+
+#include <vector>
+#include "model.h"
+#include "restart.h"
+#include "utils.h"
+
+/**
+ * Outcome of a parallel generation
+ */
+struct GenerationResult {
+	bool success;
+	/** The winning seed, and its position in the list of seeds */
+	int seed, index;
+	/** The tile of each block generated with the winning seed */
+	Array3D<int> observed;
+	/** Statistics of every attempt made, on all the threads */
+	RestartStatistics statistics;
+};
+
+/**
+ * Try a list of seeds on several threads, each one running its own copy of a model.
+ * The winner is the first seed of the list which succeeds, whatever the scheduling:
+ * once a seed succeeds, only the attempts on later seeds are cancelled, so the same
+ * list of seeds always gives the same winner (with a restart policy in steps, not in seconds).
+ */
+class ParallelRunner {
+public:
+	/**
+	 * @param model the configured model to copy for each thread
+	 * @param threads number of concurrent attempts, 0 for the number of hardware threads
+	 */
+	ParallelRunner(const Model &model, unsigned threads = 0);
+
+	/**
+	 * Run the seeds concurrently until the first success in the list
+	 * @param seeds the seeds to try, in order of preference
+	 * @return the winning seed and its generated grid, success is false if no seed succeeds
+	 */
+	GenerationResult Run(const std::vector<int> &seeds);
+
+	/**
+	 * Give the attempt on the k-th seed of the list the budget of the attempt k of the policy
+	 */
+	void setRestartPolicy(const RestartPolicy &policy);
+
+private:
+	std::vector<Model> models;
+	RestartPolicy policy;
+};
+
+#endif //WFCTILEMAPGENERATION_PARALLEL_H
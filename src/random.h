@@ -0,0 +1,128 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_RANDOM_H
+#define WFCTILEMAPGENERATION_RANDOM_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * xoshiro256** pseudo-random generator (Blackman and Vigna, http://prng.di.unimi.it/)
+ * Small and fully inlined, for sequences of draws made in a fixed order, like the seeds tried by the viewer.
+ * The models use Philox, below, so that their draws do not depend on the order.
+ */
+class Random {
+public:
+	/**
+	 * Seed the 256 bits of state from a 64 bits seed with splitmix64, as recommended by the authors
+	 */
+	explicit Random(uint64_t seed = 0) {
+		for (int k = 0; k < 4; k++) {
+			seed += 0x9E3779B97F4A7C15ULL;
+			uint64_t z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			s[k] = z ^ (z >> 31);
+		}
+	}
+
+	/**
+	 * @return 64 random bits
+	 */
+	uint64_t next() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	/**
+	 * @return a uniform double in [0, 1), from the 53 high bits of next()
+	 */
+	double uniform() {
+		return double(next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	double operator()() { return uniform(); }
+
+	/**
+	 * Fill values[0, n) with uniform doubles in [0, scale), the same as n calls to uniform() times scale
+	 */
+	void fill(double *values, size_t n, double scale = 1) {
+		const double unit = scale / 9007199254740992.0;
+		for (size_t k = 0; k < n; k++)
+			values[k] = double(next() >> 11) * unit;
+	}
+
+private:
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+/**
+ * Philox4x32-10 counter-based generator (Salmon et al., Parallel random numbers: as easy as 1, 2, 3)
+ * The random bits are a pure function of the seed and of a counter of 4 x 32 bits, here the coordinates
+ * (x, y, z) of a cell and an index: a draw does not depend on the draws before it, so the worlds do not
+ * depend on the order the cells are visited in, nor on how the generation is split between threads.
+ */
+class Philox {
+public:
+	explicit Philox(uint64_t seed = 0) {
+		key[0] = uint32_t(seed);
+		key[1] = uint32_t(seed >> 32);
+	}
+
+	/**
+	 * @return a uniform double in [0, 1) for the counter (x, y, z, n)
+	 */
+	double uniform(uint32_t x, uint32_t y, uint32_t z, uint32_t n) const {
+		uint32_t counter[4] = {x, y, z, n};
+		Block(counter, key);
+		uint64_t bits = (uint64_t(counter[0]) << 32) | counter[1];
+		return double(bits >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	/**
+	 * Fill values[0, count) with uniform doubles in [0, scale), for the counters (x, y, z, n)
+	 * @param positions the coordinates (x, y, z) of each value, 3 per value
+	 */
+	void fill(double *values, const int *positions, size_t count, uint32_t n, double scale = 1) const {
+		for (size_t k = 0; k < count; k++, positions += 3)
+			values[k] = uniform(positions[0], positions[1], positions[2], n) * scale;
+	}
+
+private:
+	uint32_t key[2];
+
+	/**
+	 * Replace the counter by its 10 rounds Philox4x32 encryption under the key
+	 */
+	static void Block(uint32_t counter[4], const uint32_t seedKey[2]) {
+		uint32_t k0 = seedKey[0], k1 = seedKey[1];
+		for (int round = 0; round < 10; round++) {
+			uint64_t p0 = uint64_t(0xD2511F53) * counter[0], p1 = uint64_t(0xCD9E8D57) * counter[2];
+			uint32_t c1 = counter[1], c3 = counter[3];
+			counter[0] = uint32_t(p1 >> 32) ^ c1 ^ k0;
+			counter[1] = uint32_t(p1);
+			counter[2] = uint32_t(p0 >> 32) ^ c3 ^ k1;
+			counter[3] = uint32_t(p0);
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+	}
+};
+
+#endif //WFCTILEMAPGENERATION_RANDOM_H
@@ -0,0 +1,82 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "restart.h"
+
+#include <climits>
+#include <cmath>
+
+void RestartStatistics::add(const Model::Statistics &run) {
+	attempts++;
+	if (run.status == Model::Contradiction) failures++;
+	if (run.status == Model::Aborted) aborted++;
+	steps += run.steps;
+	contradictions += run.contradictions;
+	seconds += run.seconds;
+	learned += run.learned;
+}
+
+void RestartStatistics::add(const RestartStatistics &other) {
+	attempts += other.attempts;
+	failures += other.failures;
+	aborted += other.aborted;
+	steps += other.steps;
+	contradictions += other.contradictions;
+	seconds += other.seconds;
+	learned += other.learned;
+}
+
+RestartPolicy::RestartPolicy(Schedule schedule, double base, double factor, Unit unit) :
+		schedule(schedule), unit(unit), base(base), factor(factor) {}
+
+RestartPolicy RestartPolicy::Parse(std::string schedule, double base, double factor, std::string unit) {
+	Schedule parsed = Unlimited;
+	if (schedule == "luby") parsed = Luby;
+	else if (schedule == "geometric") parsed = Geometric;
+	else if (schedule == "constant") parsed = Constant;
+	// a budget of 0 is unlimited, which would silently turn the restarts off
+	if (parsed != Unlimited && base <= 0) Error(("The restart policy " + schedule + " needs a positive base").c_str());
+	return RestartPolicy(parsed, base, factor, unit == "seconds" ? Seconds : Steps);
+}
+
+long RestartPolicy::LubyTerm(long i) {
+	// i = 2^k - 1 ends a block, whose last term is 2^(k - 1); otherwise the sequence repeats from its start
+	while (true) {
+		long k = 1;
+		while ((1L << k) - 1 < i) k++;
+		if ((1L << k) - 1 == i) return 1L << (k - 1);
+		i -= (1L << (k - 1)) - 1;
+	}
+}
+
+double RestartPolicy::budget(int attempt) const {
+	double limit = 0;
+	switch (schedule) {
+		case Constant: limit = base; break;
+		case Luby: limit = base * LubyTerm(attempt + 1); break;
+		case Geometric: limit = base * std::pow(factor, attempt); break;
+		default: break;
+	}
+	// a budget no step count can reach (the geometric one overflows after some attempts) is no budget
+	return std::isfinite(limit) && limit < double(LONG_MAX) ? limit : 0;
+}
+
+void RestartPolicy::apply(Model &model, int attempt) const {
+	double limit = budget(attempt);
+	model.setStepBudget(unit == Steps ? long(std::ceil(limit)) : 0);
+	model.setTimeBudget(unit == Seconds ? limit : 0);
+}
+
+int RestartPolicy::Run(Model &model, const std::vector<int> &seeds, RestartStatistics &statistics) const {
+	for (size_t k = 0; k < seeds.size(); k++) {
+		apply(model, k);
+		bool success = model.Run(seeds[k]);
+		statistics.add(model.getStatistics());
+		if (success) return k;
+	}
+	return -1;
+}
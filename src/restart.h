@@ -0,0 +1,94 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_RESTART_H
+#define WFCTILEMAPGENERATION_RESTART_H
+
+#include <string>
+#include <vector>
+#include "model.h"
+
+/**
+ * Statistics of a sequence of attempts: how many were made, ended in a contradiction or were aborted,
+ * and their total number of steps, contradictions (including the recovered ones), duration and nogoods learned
+ */
+struct RestartStatistics {
+	int attempts, failures, aborted;
+	long steps;
+	int contradictions;
+	double seconds;
+	int learned;
+
+	RestartStatistics() : attempts(0), failures(0), aborted(0), steps(0), contradictions(0), seconds(0), learned(0) {}
+
+	/**
+	 * Account for one more attempt
+	 */
+	void add(const Model::Statistics &run);
+
+	void add(const RestartStatistics &other);
+};
+
+/**
+ * Restart strategy: budget of the successive attempts of a generation, each with another seed.
+ * When failures show up late, giving up the attempts which last too long and restarting
+ * with another seed reaches a success sooner than running every attempt to its end.
+ * Unlimited: no budget, every attempt runs to success or contradiction
+ * Constant: every attempt gets base
+ * Luby: attempt k gets base * luby(k + 1), with the sequence 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ... (Luby et al. 1993)
+ * Geometric: attempt k gets base * factor^k
+ */
+class RestartPolicy {
+public:
+	enum Schedule {
+		Unlimited, Constant, Luby, Geometric
+	};
+
+	/**
+	 * Steps (observations) keep the attempts reproducible, Seconds do not
+	 */
+	enum Unit {
+		Steps, Seconds
+	};
+
+	Schedule schedule;
+	Unit unit;
+	double base, factor;
+
+	RestartPolicy(Schedule schedule = Unlimited, double base = 0, double factor = 2, Unit unit = Steps);
+
+	/**
+	 * Parse a policy from a sample: schedule "luby", "geometric", "constant" or anything else for Unlimited,
+	 * unit "seconds" or anything else for Steps. Every schedule but Unlimited needs a positive base.
+	 */
+	static RestartPolicy Parse(std::string schedule, double base, double factor, std::string unit);
+
+	/**
+	 * @return the budget of the attempt (0 based), 0 for unlimited, which is also the budget of the attempts
+	 * whose budget would not fit in a step count
+	 */
+	double budget(int attempt) const;
+
+	/**
+	 * Set the budget of the attempt on the model
+	 */
+	void apply(Model &model, int attempt) const;
+
+	/**
+	 * Run the seeds in order, the k-th with the budget of the attempt k, until one succeeds
+	 * @param statistics filled with the statistics of the attempts
+	 * @return the index of the successful seed, -1 if none succeeded
+	 */
+	int Run(Model &model, const std::vector<int> &seeds, RestartStatistics &statistics) const;
+
+	/**
+	 * @return the i-th term of the Luby sequence, i >= 1
+	 */
+	static long LubyTerm(long i);
+};
+
+#endif //WFCTILEMAPGENERATION_RESTART_H
@@ -0,0 +1,202 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "tileset.h"
+#include "wave.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <pugixml.hpp>
+#include <boost/algorithm/string.hpp>
+
+Tileset::Tileset(std::string name, std::string groundName) {
+	ground = -1;
+	bounds = -1;
+
+	pugi::xml_document xdoc;
+	std::string filename = "../" + name + "/data.xml";
+	if (!xdoc.load_file(filename.c_str())) {
+		std::cout << "Error during opening of samples.xml";
+	}
+	pugi::xml_node xnode = xdoc.first_child();
+
+	voxelsize = xnode.attribute("voxelsize").as_int();
+
+	xnode = xnode.first_child();
+
+	std::vector<double> tempStationary;
+	std::map<std::string, int> firstOccurrence;
+
+	for (pugi::xml_node xtile: xnode.children()) {
+		std::string tilename = xtile.attribute("name").as_string();
+		std::string sym = xtile.attribute("symmetry").as_string();
+		std::function<int(int)> a, b;
+
+		// Default sym
+		int cardinality = 1;
+		a = [](int i) { return i; };
+		b = [](int i) { return i; };
+
+		if (!sym.compare("L")) {
+			cardinality = 4;
+			a = [](int i) { return (i + 1) % 4; };
+			b = [](int i) { return i % 2 == 0 ? i + 1 : i - 1; };
+		} else if (!sym.compare("T")) {
+			cardinality = 4;
+			a = [](int i) { return (i + 1) % 4; };
+			b = [](int i) { return i % 2 == 0 ? i : 4 - i; };
+		} else if (!sym.compare("I")) {
+			cardinality = 2;
+			a = [](int i) { return 1 - i; };
+			b = [](int i) { return i; };
+		}
+
+		T = action.size();
+		firstOccurrence[tilename] = T;
+
+		if (tilename.compare(groundName) == 0) {
+			ground = T;
+		}
+
+		if (tilename.compare("bounds") == 0) {
+			bounds = T;
+		}
+
+		for (int t = 0; t < cardinality; t++) {
+			std::array<int, 8> map;
+
+			map[0] = t;
+			map[1] = a(t);
+			map[2] = a(a(t));
+			map[3] = a(a(a(t)));
+			map[4] = b(t);
+			map[5] = b(a(t));
+			map[6] = b(a(a(t)));
+			map[7] = b(a(a(a(t))));
+
+			for (int s = 0; s < 8; ++s) {
+				map[s] += T;
+			}
+
+			action.push_back(map);
+		}
+		std::cout << "Opening: " << "../" << name << "/" << tilename << ".vox" << std::endl;
+		sources.push_back(tilename + ".vox");
+		std::vector<Voxel> voxeltile = ReadVox("../" + name + "/" + tilename + ".vox");
+
+
+		tilenames.push_back(tilename + " 0");
+		voxeltiles.push_back(voxeltile);
+
+		for (int t = 1; t < cardinality; t++) {
+			tilenames.push_back("" + tilename + " " + std::to_string(t));
+			voxeltiles.push_back(rotateVoxels(voxeltiles.at(T + t - 1), voxelsize));
+		}
+
+		for (int t = 0; t < cardinality; t++) {
+			double w = xtile.attribute("weight").as_double();
+			if (w == 0)
+				w = 1;
+			tempStationary.push_back(w);
+		}
+
+	}
+
+	T = action.size();
+	stationary = tempStationary;
+	propagator = Array3D<bool>(6, T, T, false);
+
+	for (pugi::xml_node xneighbor : xnode.next_sibling().children()) {
+		std::string text = xneighbor.attribute("left").as_string();
+		std::vector<std::string> left;
+		boost::split(left, text, [](char c) { return c == ' '; });
+		text = xneighbor.attribute("right").as_string();
+		std::vector<std::string> right;
+		boost::split(right, text, [](char c) { return c == ' '; });
+
+		int L = action[firstOccurrence[left[0]]][left.size() == 1 ? 0 : std::atoi(left[1].c_str())];
+		int D = action[L][1];
+		int R = action[firstOccurrence[right[0]]][right.size() == 1 ? 0 : std::atoi(right[1].c_str())];
+		int U = action[R][1];
+
+		if (strcmp(xneighbor.name(), "horizontal") == 0) {
+			propagator.set(0, R, L, true);
+			propagator.set(0, action[R][6], action[L][6], true);
+			propagator.set(0, action[L][4], action[R][4], true);
+			propagator.set(0, action[L][2], action[R][2], true);
+
+			propagator.set(1, U, D, true);
+			propagator.set(1, action[D][6], action[U][6], true);
+			propagator.set(1, action[U][4], action[D][4], true);
+			propagator.set(1, action[D][2], action[U][2], true);
+		} else {
+			for (int g = 0; g < 8; g++) {
+				propagator.set(4, action[L][g], action[R][g], true);
+			}
+		}
+	}
+
+	for (int t2 = 0; t2 < T; t2++)
+		for (int t1 = 0; t1 < T; t1++) {
+			propagator.set(2, t2, t1, propagator.get(0, t1, t2));
+			propagator.set(3, t2, t1, propagator.get(1, t1, t2));
+			propagator.set(5, t2, t1, propagator.get(4, t1, t2));
+		}
+
+	Compile();
+}
+
+void Tileset::Compile() {
+	supported = std::vector<std::vector<int>>(6 * T);
+	supporters = std::vector<std::vector<int>>(6 * T);
+	initialCompatible = std::vector<int>(6 * T, 0);
+	W = Wave::Words(T);
+	masks = AlignedVector<uint64_t>(6 * T * W, 0);
+	for (int d = 0; d < 6; d++)
+		for (int t1 = 0; t1 < T; t1++)
+			for (int t2 = 0; t2 < T; t2++)
+				if (propagator.get(d, t2, t1)) {
+					supported[d * T + t1].push_back(t2);
+					supporters[d * T + t2].push_back(t1);
+					initialCompatible[t2 * 6 + d]++;
+					masks[(d * T + t1) * W + t2 / 64] |= uint64_t(1) << (t2 % 64);
+				}
+
+	weightLogWeights = std::vector<double>(T, 0);
+	startingSumOfWeights = 0;
+	startingSumOfWeightLogWeights = 0;
+	for (int t = 0; t < T; t++) {
+		weightLogWeights[t] = stationary[t] * std::log(stationary[t]);
+		startingSumOfWeights += stationary[t];
+		startingSumOfWeightLogWeights += weightLogWeights[t];
+	}
+}
+
+double Tileset::startingEntropy() const {
+	return std::log(startingSumOfWeights) - startingSumOfWeightLogWeights / startingSumOfWeights;
+}
+
+std::vector<int> Tileset::find(std::string name) const {
+	std::vector<int> tiles;
+	bool orientation = name.find(' ') != std::string::npos;
+	for (int t = 0; t < T; t++) {
+		const std::string &tilename = tilenames[t];
+		if (orientation ? tilename == name : tilename.compare(0, tilename.rfind(' '), name) == 0)
+			tiles.push_back(t);
+	}
+	return tiles;
+}
+
+std::vector<Voxel> Tileset::rotateVoxels(std::vector<Voxel> array, size_t size) {
+	std::vector<Voxel> result;
+	for (Voxel voxel : array) {
+		result.push_back(Voxel(size - 1 - voxel.y, voxel.x, voxel.z, voxel.color));
+	}
+	return result;
+}
@@ -0,0 +1,137 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_TILESET_H
+#define WFCTILEMAPGENERATION_TILESET_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "utils.h"
+#include "voxels.h"
+
+/**
+ * Compiled set of tiles of a simple tiled model: the tiles after symmetry expansion,
+ * their weights, voxels and adjacency rules.
+ * A Tileset is never modified once loaded, so it can be shared (through a
+ * std::shared_ptr<const Tileset>) by any number of models running concurrently.
+ */
+class Tileset {
+public:
+	/**
+	 * Load the tileset described by ../name/data.xml and its .vox files
+	 * @param name the name of the folder of the tileset
+	 * @param groundName the name of the tile forced on the lowest layer, if any
+	 */
+	Tileset(std::string name, std::string groundName);
+
+	/**
+	 * Load a tileset through its compiled cache ../name/name.tileset, next to its data.xml.
+	 * The cache is used if its content hash matches data.xml, the ground name and the .vox files,
+	 * otherwise the tileset is parsed from ../name/ and the cache is rewritten.
+	 * @param name the name of the folder of the tileset
+	 * @param groundName the name of the tile forced on the lowest layer, if any
+	 */
+	static std::shared_ptr<const Tileset> Load(std::string name, std::string groundName);
+
+	/** Number of tiles, after symmetry expansion */
+	int T;
+
+	/** Index of the ground and bounds tiles, -1 if the tileset has none */
+	int ground, bounds;
+
+	int voxelsize;
+
+	std::vector<std::string> tilenames;
+	std::vector<std::vector<Voxel>> voxeltiles;
+
+	/** Weight w of each tile, and its w * log(w) */
+	std::vector<double> stationary, weightLogWeights;
+	double startingSumOfWeights, startingSumOfWeightLogWeights;
+
+	/** action[t][s]: tile t transformed by the symmetry s (0-3 rotations, 4-7 reflections) */
+	std::vector<std::array<int, 8>> action;
+
+	/** propagator.get(d, t2, t1): t2 may be placed next to t1 when t1 is its neighbor in direction d */
+	Array3D<bool> propagator;
+
+	/**
+	 * supported[d * T + t1]: tiles t2 allowed in a cell whose neighbor in direction d is t1
+	 */
+	std::vector<std::vector<int>> supported;
+
+	/**
+	 * supporters[d * T + t2]: tiles t1 allowing t2 in a cell whose neighbor in direction d is t1
+	 */
+	std::vector<std::vector<int>> supporters;
+
+	/**
+	 * initialCompatible[t * 6 + d]: number of tiles compatible with t in direction d
+	 */
+	std::vector<int> initialCompatible;
+
+	/** Number of 64 bits words of a set of tiles, the same as in a cell of the Wave */
+	int W;
+
+	/**
+	 * Same as supported, as bitsets: bit t2 of the W words at masks[(d * T + t1) * W] is set
+	 * if t2 is allowed in a cell whose neighbor in direction d is t1
+	 */
+	AlignedVector<uint64_t> masks;
+
+	/**
+	 * @return the T consecutive masks of the direction d
+	 */
+	const uint64_t *mask(int d) const { return &masks[d * T * W]; }
+
+	/**
+	 * @return the entropy of a cell where every tile is still possible
+	 */
+	double startingEntropy() const;
+
+	/**
+	 * @return the tiles of a name: "name k" for its k-th orientation, "name" for all its orientations,
+	 * none if the tileset has no such tile
+	 */
+	std::vector<int> find(std::string name) const;
+
+private:
+	/** The .vox files the tileset was built from */
+	std::vector<std::string> sources;
+
+	Tileset() {}
+
+	/**
+	 * Derive the support lists, counters and entropy sums from the propagator and weights
+	 */
+	void Compile();
+
+	/**
+	 * Read a compiled tileset, memory-mapping the file
+	 * @return false if the file is missing, of another version or built from other inputs
+	 */
+	bool ReadCache(std::string filename, std::string name, std::string groundName);
+
+	void WriteCache(std::string filename, std::string name, std::string groundName) const;
+
+	/**
+	 * @return a 64 bits content hash of data.xml, the ground name and the .vox files
+	 */
+	static uint64_t Hash(std::string name, std::string groundName, const std::vector<std::string> &sources);
+
+	/**
+	 * Perform a 90deg Rotate of a block of voxels on the x-y coordinates
+	 * @param array the vector containing all the voxels of the block
+	 * @param size the width=height=depth of the block
+	 * @return the rotated block of voxels
+	 */
+	static std::vector<Voxel> rotateVoxels(std::vector<Voxel> array, size_t size);
+};
+
+#endif //WFCTILEMAPGENERATION_TILESET_H
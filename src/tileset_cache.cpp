@@ -0,0 +1,243 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#include "tileset.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Layout of a compiled tileset, in native byte order:
+ *   "WFCT", version, content hash
+ *   .vox sources: count, then (length, characters) each
+ *   T, ground, bounds, voxelsize
+ *   tile names: (length, characters) each
+ *   weights: T doubles
+ *   symmetries: T x 8 ints
+ *   propagator: 6 x T rows of (T + 63) / 64 words, bit t1 of row (d, t2) is propagator(d, t2, t1)
+ *   voxels of each tile, already rotated: count, then (x, y, z, color) bytes each
+ */
+
+static const char CACHE_MAGIC[4] = {'W', 'F', 'C', 'T'};
+static const uint32_t CACHE_VERSION = 1;
+
+static void HashBytes(uint64_t &hash, const void *bytes, size_t size) {
+	// FNV-1a
+	const unsigned char *p = (const unsigned char *) bytes;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+static bool HashFile(uint64_t &hash, std::string filename) {
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+
+	char buffer[1 << 16];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		HashBytes(hash, buffer, read);
+	fclose(file);
+	return true;
+}
+
+uint64_t Tileset::Hash(std::string name, std::string groundName, const std::vector<std::string> &sources) {
+	uint64_t hash = 14695981039346656037ULL;
+	HashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+	HashBytes(hash, groundName.c_str(), groundName.size() + 1);
+	if (!HashFile(hash, "../" + name + "/data.xml")) return 0;
+	for (const std::string &source : sources)
+		if (!HashFile(hash, "../" + name + "/" + source)) return 0;
+	return hash;
+}
+
+std::shared_ptr<const Tileset> Tileset::Load(std::string name, std::string groundName) {
+	std::string filename = "../" + name + "/" + name + ".tileset";
+
+	std::shared_ptr<Tileset> tileset(new Tileset());
+	if (tileset->ReadCache(filename, name, groundName)) {
+		std::cout << "Loaded compiled tileset " << filename << std::endl;
+		return tileset;
+	}
+
+	tileset = std::make_shared<Tileset>(name, groundName);
+	tileset->WriteCache(filename, name, groundName);
+	return tileset;
+}
+
+/**
+ * Sequential reader over a memory-mapped file, every read is bounds checked
+ */
+struct CacheReader {
+	const char *position, *end;
+
+	size_t remaining() const { return end - position; }
+
+	bool read(void *out, size_t size) {
+		if (remaining() < size) return false;
+		memcpy(out, position, size);
+		position += size;
+		return true;
+	}
+
+	template<typename T>
+	bool read(T &value) { return read(&value, sizeof(T)); }
+
+	bool read(std::string &value) {
+		uint32_t length;
+		if (!read(length) || remaining() < length) return false;
+		value.assign(position, length);
+		position += length;
+		return true;
+	}
+};
+
+bool Tileset::ReadCache(std::string filename, std::string name, std::string groundName) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return false;
+
+	CacheReader in = {(const char *) mapping, (const char *) mapping + info.st_size};
+	bool valid = false;
+
+	char magic[4];
+	uint32_t version, count;
+	uint64_t hash;
+	// the counts read are bounded by the bytes left, so that a corrupt cache is rejected instead of
+	// allocating the sizes it claims: each source and each tile takes at least 4 bytes
+	if (in.read(magic, 4) && !memcmp(magic, CACHE_MAGIC, 4) && in.read(version) && version == CACHE_VERSION
+		&& in.read(hash) && in.read(count) && in.remaining() / 4 >= count) {
+		sources.resize(count);
+		valid = true;
+		for (uint32_t k = 0; k < count && valid; k++)
+			valid = in.read(sources[k]);
+		valid = valid && hash != 0 && hash == Hash(name, groundName, sources);
+	}
+
+	if (valid) {
+		int32_t header[4];
+		valid = in.read(header, sizeof(header)) && header[0] > 0 && in.remaining() / 4 >= size_t(header[0]);
+		T = header[0];
+		ground = header[1];
+		bounds = header[2];
+		voxelsize = header[3];
+	}
+
+	if (valid) {
+		tilenames.resize(T);
+		for (int t = 0; t < T && valid; t++)
+			valid = in.read(tilenames[t]);
+
+		stationary.resize(T);
+		action.resize(T);
+		valid = valid && in.read(&stationary[0], T * sizeof(double)) && in.read(&action[0], T * sizeof(action[0]));
+
+		// indices of tiles, used without further checks by the models
+		valid = valid && ground >= -1 && ground < T && bounds >= -1 && bounds < T;
+		for (int t = 0; t < T && valid; t++)
+			for (int s = 0; s < 8 && valid; s++)
+				valid = action[t][s] >= 0 && action[t][s] < T;
+	}
+
+	if (valid) {
+		size_t W = (T + 63) / 64;
+		std::vector<uint64_t> row(W);
+		valid = in.remaining() / (6 * W * sizeof(uint64_t)) >= size_t(T);
+		if (valid) propagator = Array3D<bool>(6, T, T, false);
+		for (int d = 0; d < 6 && valid; d++)
+			for (int t2 = 0; t2 < T && valid; t2++) {
+				valid = in.read(&row[0], W * sizeof(uint64_t));
+				for (int t1 = 0; t1 < T && valid; t1++)
+					propagator.set(d, t2, t1, (row[t1 / 64] >> (t1 % 64)) & 1);
+			}
+	}
+
+	if (valid) {
+		voxeltiles.resize(T);
+		for (int t = 0; t < T && valid; t++) {
+			valid = in.read(count) && in.remaining() / 4 >= count;
+			for (uint32_t k = 0; k < count && valid; k++, in.position += 4)
+				voxeltiles[t].push_back(Voxel(in.position[0], in.position[1], in.position[2], in.position[3]));
+		}
+	}
+
+	munmap(mapping, info.st_size);
+	if (valid) Compile();
+	return valid;
+}
+
+static void WriteString(FILE *file, const std::string &value) {
+	uint32_t length = value.size();
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(value.data(), 1, length, file);
+}
+
+void Tileset::WriteCache(std::string filename, std::string name, std::string groundName) const {
+	uint64_t hash = Hash(name, groundName, sources);
+	if (hash == 0) return;
+
+	// write to a temporary file first, so concurrent jobs never map a partial cache
+	std::string temporary = filename + "." + std::to_string(getpid());
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if (!file) {
+		std::cout << "Could not write the compiled tileset " << filename << std::endl;
+		return;
+	}
+
+	uint32_t count = sources.size();
+	fwrite(CACHE_MAGIC, 1, 4, file);
+	fwrite(&CACHE_VERSION, sizeof(CACHE_VERSION), 1, file);
+	fwrite(&hash, sizeof(hash), 1, file);
+	fwrite(&count, sizeof(count), 1, file);
+	for (const std::string &source : sources)
+		WriteString(file, source);
+
+	int32_t header[4] = {T, ground, bounds, voxelsize};
+	fwrite(header, sizeof(header), 1, file);
+	for (const std::string &tilename : tilenames)
+		WriteString(file, tilename);
+	fwrite(&stationary[0], sizeof(double), T, file);
+	fwrite(&action[0], sizeof(action[0]), T, file);
+
+	size_t W = (T + 63) / 64;
+	for (int d = 0; d < 6; d++)
+		for (int t2 = 0; t2 < T; t2++) {
+			std::vector<uint64_t> row(W, 0);
+			for (int t1 = 0; t1 < T; t1++)
+				if (propagator.get(d, t2, t1)) row[t1 / 64] |= uint64_t(1) << (t1 % 64);
+			fwrite(&row[0], sizeof(uint64_t), W, file);
+		}
+
+	for (const std::vector<Voxel> &voxels : voxeltiles) {
+		count = voxels.size();
+		fwrite(&count, sizeof(count), 1, file);
+		for (const Voxel &v : voxels) {
+			int8_t bytes[4] = {v.x, v.y, v.z, v.color};
+			fwrite(bytes, 1, 4, file);
+		}
+	}
+
+	bool written = !ferror(file);
+	written = fclose(file) == 0 && written;
+	if (!written || rename(temporary.c_str(), filename.c_str()) != 0) {
+		remove(temporary.c_str());
+		std::cout << "Could not write the compiled tileset " << filename << std::endl;
+	}
+}
@@ -33,9 +33,11 @@ void GLAPIENTRY MessageCallback(GLenum source,
 
 
 
-size_t rotateVector(const std::vector<double>& a, double between_zero_and_one)
+size_t rotateVector(ArrayView<const double> a, double between_zero_and_one)
 {
-	double sum = std::accumulate(a.begin(), a.end(), 0.0);
+	double sum = 0;
+	for (double v : a)
+		sum += v;
 
 	if (sum == 0.0) {
 		return std::floor(between_zero_and_one * a.size());
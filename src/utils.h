@@ -14,6 +14,50 @@
 #include <vector>
 #include <gl.h>
 #include "stacktrace.h"
+#include "memory.h"
+
+/**
+ * Non-owning view on size elements of an array, stride elements apart (1 for contiguous elements).
+ * It never allocates, and stays valid as long as the array it comes from is not resized.
+ * @tparam T The type of the elements, const for a read-only view
+ */
+template<typename T>
+struct ArrayView {
+	T *pointer;
+	size_t length, stride;
+
+	ArrayView() : pointer(nullptr), length(0), stride(1) {}
+
+	ArrayView(T *pointer, size_t length, size_t stride = 1) : pointer(pointer), length(length), stride(stride) {}
+
+	/**
+	 * Read-only view on the content of a vector
+	 */
+	template<typename U>
+	ArrayView(const std::vector<U> &vector) : pointer(vector.data()), length(vector.size()), stride(1) {}
+
+	size_t size() const { return length; }
+
+	T &operator[](size_t i) const { return pointer[i * stride]; }
+
+	struct iterator {
+		T *pointer;
+		size_t stride;
+
+		T &operator*() const { return *pointer; }
+
+		iterator &operator++() {
+			pointer += stride;
+			return *this;
+		}
+
+		bool operator!=(const iterator &other) const { return pointer != other.pointer; }
+	};
+
+	iterator begin() const { return iterator{pointer, stride}; }
+
+	iterator end() const { return iterator{pointer + length * stride, stride}; }
+};
 
 /**
  * Print an error message in the logs and stp the process
@@ -27,7 +71,7 @@ void Error(const char *info);
  * @param between_zero_and_one the seed
  * @return the rotated vector
  */
-size_t rotateVector(const std::vector<double> &a, double between_zero_and_one);
+size_t rotateVector(ArrayView<const double> a, double between_zero_and_one);
 
 /**
  * Check that index is between 0 and bounds and generate an Error if not
@@ -45,79 +89,191 @@ void MessageCallback(GLenum source,
 					 const GLchar *message,
 					 const void *userParam);
 
+/**
+ * Bounds checking policies of Array3D, Array4D and Wave.
+ * CheckedBounds stops the process with an Error on an index out of bounds,
+ * UncheckedBounds compiles to nothing.
+ */
+struct CheckedBounds {
+	static void check(size_t index, size_t bound) { checkBounds(index, bound); }
+};
+
+struct UncheckedBounds {
+	static void check(size_t, size_t) {}
+};
+
+/**
+ * Indices are checked in debug builds, or when WFC_CHECK_BOUNDS is defined, and not in release builds
+ */
+#if defined(NDEBUG) && !defined(WFC_CHECK_BOUNDS)
+typedef UncheckedBounds DefaultBoundsCheck;
+#else
+typedef CheckedBounds DefaultBoundsCheck;
+#endif
+
 /**
  * 4D array, made with 1D vector for efficiency
  * @tparam T The type of the array
+ * @tparam Check The bounds checking policy
+ * @tparam Alloc The allocator of the elements, cache line aligned by default (see memory.h)
  */
-template<typename T>
+template<typename T, typename Check = DefaultBoundsCheck, typename Alloc = AlignedAllocator<T>>
 struct Array4D {
 	size_t dim1, dim2, dim3, dim4;
-	std::vector<T> data;
+	std::vector<T, Alloc> data;
 
-	size_t getIndex(size_t d1, size_t d2, size_t d3, size_t d4) {
-		checkBounds(d1, dim1);
-		checkBounds(d2, dim2);
-		checkBounds(d3, dim3);
-		checkBounds(d4, dim4);
+	size_t getIndex(size_t d1, size_t d2, size_t d3, size_t d4) const {
+		Check::check(d1, dim1);
+		Check::check(d2, dim2);
+		Check::check(d3, dim3);
+		Check::check(d4, dim4);
 		return d1 * dim2 * dim3 * dim4 + d2 * dim3 * dim4 + d3 * dim4 + d4;
 	}
 
 public:
 	Array4D(size_t dim1, size_t dim2, size_t dim3, size_t dim4, T defaultValue) :
 			dim1(dim1), dim2(dim2), dim3(dim3), dim4(dim4) {
-		data = std::vector<T>(dim1 * dim2 * dim3 * dim4, defaultValue);
+		data = std::vector<T, Alloc>(dim1 * dim2 * dim3 * dim4, defaultValue);
 	}
 
 	Array4D() {}
 
-	T get(size_t d1, size_t d2, size_t d3, size_t d4) {
-		return data.at(getIndex(d1, d2, d3, d4));
+	T get(size_t d1, size_t d2, size_t d3, size_t d4) const {
+		return data[getIndex(d1, d2, d3, d4)];
 	}
 
-	std::vector<T> get(size_t d1, size_t d2, size_t d3) {
-		return std::vector<T>(&data[getIndex(d1, d2, d3, 0)], &data[getIndex(d1, d2, d3, dim4 - 1)]);
+	/**
+	 * @return a view on the dim4 elements at (d1, d2, d3)
+	 */
+	ArrayView<T> get(size_t d1, size_t d2, size_t d3) {
+		return ArrayView<T>(row(d1, d2, d3), dim4);
+	}
+
+	ArrayView<const T> get(size_t d1, size_t d2, size_t d3) const {
+		return ArrayView<const T>(row(d1, d2, d3), dim4);
 	}
 
 	void set(size_t d1, size_t d2, size_t d3, size_t d4, T value) {
-		data.at(getIndex(d1, d2, d3, d4)) = value;
+		data[getIndex(d1, d2, d3, d4)] = value;
 	}
+
+	/**
+	 * Unchecked access to the dim4 contiguous elements at (d1, d2, d3), only the row itself is checked
+	 * @return a pointer to the element (d1, d2, d3, 0)
+	 */
+	T *row(size_t d1, size_t d2, size_t d3) {
+		return &data[0] + getIndex(d1, d2, d3, 0);
+	}
+
+	const T *row(size_t d1, size_t d2, size_t d3) const {
+		return &data[0] + getIndex(d1, d2, d3, 0);
+	}
+
+	size_t rowSize() const { return dim4; }
+
+	/**
+	 * Unchecked access to the whole array, in d1-major order
+	 */
+	T *begin() { return &data[0]; }
+
+	T *end() { return &data[0] + data.size(); }
+
+	const T *begin() const { return &data[0]; }
+
+	const T *end() const { return &data[0] + data.size(); }
 };
 
 /**
  * 3D array, made with 1D vector for efficiency
  * @tparam T The type of the array
+ * @tparam Check The bounds checking policy
+ * @tparam Alloc The allocator of the elements, cache line aligned by default (see memory.h)
  */
-template<typename T>
+template<typename T, typename Check = DefaultBoundsCheck, typename Alloc = AlignedAllocator<T>>
 struct Array3D {
 	size_t width, height, depht;
-	std::vector<T> data;
+	std::vector<T, Alloc> data;
 
-	size_t getIndex(size_t x, size_t y, size_t z) {
-		checkBounds(x, width);
-		checkBounds(y, height);
-		checkBounds(z, depht);
+	size_t getIndex(size_t x, size_t y, size_t z) const {
+		Check::check(x, width);
+		Check::check(y, height);
+		Check::check(z, depht);
 		return x * height * depht + y * depht + z;
 	}
 
 public:
 	Array3D(size_t width, size_t height, size_t depht, T defaultValue) :
 			width(width), height(height), depht(depht) {
-		data = std::vector<T>(width * height * depht, defaultValue);
+		data = std::vector<T, Alloc>(width * height * depht, defaultValue);
 	}
 
 	Array3D() {}
 
-	T get(size_t x, size_t y, size_t z) {
-		return data.at(getIndex(x, y, z));
+	T get(size_t x, size_t y, size_t z) const {
+		return data[getIndex(x, y, z)];
 	}
 
 	void set(size_t x, size_t y, size_t z, T value) {
-		data.at(getIndex(x, y, z)) = value;
+		data[getIndex(x, y, z)] = value;
+	}
+
+	/**
+	 * @return a view on the depht elements at (x, y)
+	 */
+	ArrayView<T> get(size_t x, size_t y) {
+		return ArrayView<T>(row(x, y), depht);
+	}
+
+	ArrayView<const T> get(size_t x, size_t y) const {
+		return ArrayView<const T>(row(x, y), depht);
+	}
+
+	/**
+	 * @return a strided view on the width elements at (y, z)
+	 */
+	ArrayView<T> alongX(size_t y, size_t z) {
+		return ArrayView<T>(&data[0] + getIndex(0, y, z), width, height * depht);
+	}
+
+	ArrayView<const T> alongX(size_t y, size_t z) const {
+		return ArrayView<const T>(&data[0] + getIndex(0, y, z), width, height * depht);
+	}
+
+	/**
+	 * @return a strided view on the height elements at (x, z)
+	 */
+	ArrayView<T> alongY(size_t x, size_t z) {
+		return ArrayView<T>(&data[0] + getIndex(x, 0, z), height, depht);
+	}
+
+	ArrayView<const T> alongY(size_t x, size_t z) const {
+		return ArrayView<const T>(&data[0] + getIndex(x, 0, z), height, depht);
 	}
 
-	std::vector<T> get(size_t d1, size_t d2) {
-		return std::vector<T>(&data[getIndex(d1, d2, 0)], &data[getIndex(d1, d2, depht - 1)]);
+	/**
+	 * Unchecked access to the depht contiguous elements at (x, y), only the row itself is checked
+	 * @return a pointer to the element (x, y, 0)
+	 */
+	T *row(size_t x, size_t y) {
+		return &data[0] + getIndex(x, y, 0);
 	}
+
+	const T *row(size_t x, size_t y) const {
+		return &data[0] + getIndex(x, y, 0);
+	}
+
+	size_t rowSize() const { return depht; }
+
+	/**
+	 * Unchecked access to the whole array, in x-major order
+	 */
+	T *begin() { return &data[0]; }
+
+	T *end() { return &data[0] + data.size(); }
+
+	const T *begin() const { return &data[0]; }
+
+	const T *end() const { return &data[0] + data.size(); }
 };
 
 #endif //WFCTILEMAPGENERATION_UTILS_H
@@ -0,0 +1,253 @@
+/**
+ * Introduction to Computer Graphics 2019
+ * Final Project: Random Tilemap Generation and Rendering
+ *
+ * Authors: Antoine Crettenand, Louis Vialar, François Quellec
+ */
+
+#ifndef WFCTILEMAPGENERATION_WAVE_H
+#define WFCTILEMAPGENERATION_WAVE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "utils.h"
+
+/**
+ * Bit-packed wave of the WFC algorithm: for each cell of the FMX x FMY x FMZ grid,
+ * the set of tiles it still allows. Cells are numbered by the Grid of the model.
+ *
+ * Two layouts of the bits are available:
+ * CellMajor: each cell stores its tiles as `words()` contiguous 64 bits words, bit t of the cell
+ * being set if tile t is allowed. Up to 512 tiles, the number of words of a cell is rounded up
+ * to 1, 2, 4 or 8 so that it matches one of the fixed widths the solver is specialized for.
+ * TileMajor: each tile stores a bit-plane over the whole grid, `planeWords()` contiguous words
+ * whose bit i is set if the cell i allows the tile, so a step in a direction of the grid
+ * is a shift of the plane.
+ *
+ * In both layouts the padding bits (after the last tile, or after the last cell) are always kept
+ * at zero, so word-level operations (and, or, popcount) can be used directly on a cell or a plane.
+ */
+class Wave {
+public:
+	enum Layout {
+		CellMajor, TileMajor
+	};
+
+	Wave() : FMX(0), FMY(0), FMZ(0), T(0), W(0), P(0), layout(CellMajor) {}
+
+	Wave(size_t FMX, size_t FMY, size_t FMZ, size_t T, Layout layout = CellMajor) :
+			FMX(FMX), FMY(FMY), FMZ(FMZ), T(T), W(Words(T)), P((FMX * FMY * FMZ + 63) / 64), layout(layout),
+			data(layout == CellMajor ? FMX * FMY * FMZ * W : T * P, 0) {}
+
+	/**
+	 * @return the number of words of a set of T tiles: 1, 2, 4 or 8 up to 512 tiles, exact above
+	 */
+	static size_t Words(size_t T) {
+		size_t exact = (T + 63) / 64;
+		if (exact > 8) return exact;
+		size_t words = 1;
+		while (words < exact) words *= 2;
+		return words;
+	}
+
+	/**
+	 * @return the number of cells of the grid
+	 */
+	size_t cells() const { return FMX * FMY * FMZ; }
+
+	/**
+	 * @return the number of 64 bits words used by a cell, with the CellMajor layout
+	 */
+	size_t words() const { return W; }
+
+	/**
+	 * @return the number of 64 bits words used by the plane of a tile, with the TileMajor layout
+	 */
+	size_t planeWords() const { return P; }
+
+	Layout getLayout() const { return layout; }
+
+	/**
+	 * @return a pointer to the first word of the cell i, with the CellMajor layout
+	 */
+	uint64_t *cell(size_t i) {
+		DefaultBoundsCheck::check(i, cells());
+		return &data[i * W];
+	}
+
+	const uint64_t *cell(size_t i) const {
+		DefaultBoundsCheck::check(i, cells());
+		return &data[i * W];
+	}
+
+	/**
+	 * @return a pointer to the first word of the plane of the tile t, with the TileMajor layout
+	 */
+	uint64_t *plane(size_t t) {
+		DefaultBoundsCheck::check(t, T);
+		return &data[t * P];
+	}
+
+	const uint64_t *plane(size_t t) const {
+		DefaultBoundsCheck::check(t, T);
+		return &data[t * P];
+	}
+
+	bool get(size_t i, size_t t) const { return (data[word(i, t)] & bit(i, t)) != 0; }
+
+	void set(size_t i, size_t t, bool value) {
+		if (value) data[word(i, t)] |= bit(i, t);
+		else data[word(i, t)] &= ~bit(i, t);
+	}
+
+	/**
+	 * Remove the tile t from the cell i
+	 */
+	void ban(size_t i, size_t t) {
+		data[word(i, t)] &= ~bit(i, t);
+	}
+
+	/**
+	 * Allow every tile in the cell i
+	 */
+	void fillCell(size_t i) {
+		if (layout == TileMajor) {
+			for (size_t t = 0; t < T; t++) set(i, t, true);
+			return;
+		}
+		uint64_t *c = cell(i);
+		for (size_t w = 0; w < W; w++) c[w] = lastWordMask(w);
+	}
+
+	/**
+	 * Allow (value = true) or forbid (value = false) every tile in every cell
+	 */
+	void fill(bool value) {
+		if (layout == TileMajor) {
+			for (size_t t = 0; t < T; t++)
+				for (size_t w = 0; w < P; w++) plane(t)[w] = value ? lastPlaneWordMask(w) : 0;
+			return;
+		}
+		for (size_t i = 0; i < cells(); i++)
+			if (value) fillCell(i);
+			else clearCell(i);
+	}
+
+	/**
+	 * Forbid every tile in the cell i
+	 */
+	void clearCell(size_t i) {
+		if (layout == TileMajor) {
+			for (size_t t = 0; t < T; t++) ban(i, t);
+			return;
+		}
+		uint64_t *c = cell(i);
+		for (size_t w = 0; w < W; w++) c[w] = 0;
+	}
+
+	/**
+	 * Keep only the tile t in the cell i
+	 */
+	void assign(size_t i, size_t t) {
+		clearCell(i);
+		set(i, t, true);
+	}
+
+	/**
+	 * @return the number of tiles still allowed in the cell i
+	 */
+	int count(size_t i) const {
+		int n = 0;
+		if (layout == TileMajor) {
+			for (size_t t = 0; t < T; t++) n += get(i, t);
+			return n;
+		}
+		const uint64_t *c = cell(i);
+		for (size_t w = 0; w < W; w++) n += popcount(c[w]);
+		return n;
+	}
+
+	/**
+	 * @return the lowest tile allowed in the cell i, -1 if the cell is empty
+	 */
+	int first(size_t i) const {
+		if (layout == TileMajor) {
+			for (size_t t = 0; t < T; t++)
+				if (get(i, t)) return int(t);
+			return -1;
+		}
+		const uint64_t *c = cell(i);
+		for (size_t w = 0; w < W; w++)
+			if (c[w]) return int(w * 64 + lowestBit(c[w]));
+		return -1;
+	}
+
+	/**
+	 * Intersect the cell i with a mask of `words()` words, with the CellMajor layout
+	 * @return true if the cell changed
+	 */
+	bool andCell(size_t i, const uint64_t *mask) {
+		uint64_t *c = cell(i), diff = 0;
+		for (size_t w = 0; w < W; w++) {
+			uint64_t v = c[w] & mask[w];
+			diff |= v ^ c[w];
+			c[w] = v;
+		}
+		return diff != 0;
+	}
+
+	/**
+	 * Union of the cell i with a mask of `words()` words, with the CellMajor layout
+	 */
+	void orCell(size_t i, const uint64_t *mask) {
+		uint64_t *c = cell(i);
+		for (size_t w = 0; w < W; w++) c[w] |= mask[w];
+	}
+
+	/**
+	 * @return the valid bits of the word w of a cell, i.e. without the padding after the last tile
+	 */
+	uint64_t lastWordMask(size_t w) const {
+		if (w * 64 >= T) return 0;
+		size_t remaining = T - w * 64;
+		return remaining >= 64 ? ~uint64_t(0) : (uint64_t(1) << remaining) - 1;
+	}
+
+	/**
+	 * @return the valid bits of the word w of a plane, i.e. without the padding after the last cell
+	 */
+	uint64_t lastPlaneWordMask(size_t w) const {
+		size_t cells = this->cells();
+		if (w * 64 >= cells) return 0;
+		size_t remaining = cells - w * 64;
+		return remaining >= 64 ? ~uint64_t(0) : (uint64_t(1) << remaining) - 1;
+	}
+
+	static int popcount(uint64_t v) { return __builtin_popcountll(v); }
+
+	static int lowestBit(uint64_t v) { return __builtin_ctzll(v); }
+
+private:
+	size_t FMX, FMY, FMZ, T, W, P;
+	Layout layout;
+	AlignedVector<uint64_t> data;
+
+	/**
+	 * @return the index in data of the word holding the tile t of the cell i
+	 */
+	size_t word(size_t i, size_t t) const {
+		DefaultBoundsCheck::check(i, cells());
+		DefaultBoundsCheck::check(t, T);
+		return layout == CellMajor ? i * W + (t >> 6) : t * P + (i >> 6);
+	}
+
+	/**
+	 * @return the mask of the tile t of the cell i in its word
+	 */
+	uint64_t bit(size_t i, size_t t) const {
+		return uint64_t(1) << ((layout == CellMajor ? t : i) & 63);
+	}
+};
+
+#endif //WFCTILEMAPGENERATION_WAVE_H